@@ -8,11 +8,149 @@
 #include <iostream>
 #include <vector>
 #include <climits>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
 #include <random>
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
+#include <cassert>
+#include <atomic>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "../include/playerbase.h"
 
-#define MAX_DEPTH 2 // 最大遍历深度
+#define MAX_DEPTH 2 // char 矩阵参考实现的最大遍历深度
+#define MAX_PLY 64  // 搜索栈的最大层数
+
+#ifndef TIME_LIMIT_MS
+#define TIME_LIMIT_MS 75 // 每步搜索的时间上限（毫秒），评测程序每步限时 100ms
+#endif
+#ifndef GAME_TIME_MS
+#define GAME_TIME_MS 0 // 整局搜索的总时间（毫秒），按剩余空格分给每一步，0 表示不限制
+#endif
+
+#ifndef TT_SIZE_MB
+#define TT_SIZE_MB 16 // 置换表大小（MB），在 init 中分配
+#endif
+
+#ifndef SEARCH_THREADS
+#define SEARCH_THREADS 0 // 搜索线程数，0 表示使用全部核心
+#endif
+
+#ifndef USE_BITBOARD
+#define USE_BITBOARD 1 // 1 使用位棋盘搜索，0 使用原来的 char 矩阵参考实现
+#endif
+
+#ifndef BB_WORDS
+#define BB_WORDS 3                  // 位棋盘使用的 64 位字数
+#endif
+#define BB_MAX_CELLS (BB_WORDS * 64) // 位棋盘最多能表示的格子数（可覆盖 12x12，-DBB_WORDS=9 可覆盖 24x24）
+
+#ifndef ENDGAME_EMPTIES
+#define ENDGAME_EMPTIES 12 // 剩余空格不超过这个数时精确求解终局分差，按 data 中地图的实测求解时间选取
+#endif
+
+#define EG_HASH_BITS 16     // 终局哈希表有 2^16 个表项
+#define EG_HASH_EMPTIES 6   // 剩余空格不少于这个数时查询终局哈希表
+#define EG_FASTEST_EMPTIES 5 // 剩余空格不少于这个数时按对方行动力排序（fastest-first）
+#define EG_INF (1 << 29)     // 终局哈希表中没有边界时的上下界
+
+#ifndef BOOK_FILE
+#define BOOK_FILE "data/book.bin" // 开局库文件，相对于评测程序的工作目录，由 make book 生成
+#endif
+#define BOOK_VERSION 1 // 开局库文件格式的版本号
+
+#ifndef EVAL_FILE
+#define EVAL_FILE "data/eval.bin" // 离线拟合的模式表，由 make fit 生成，没有文件时只用手写评估折算出的表
+#endif
+#define EVAL_VERSION 1        // 模式表文件格式的版本号
+#define EVAL_FILE_SCALE 256   // 模式表文件中的值以 1/256 为单位
+#define EVAL_EDGE_LEN 10      // 边模式从角出发的最大长度，稳定子只数到这个长度
+#define EVAL_DIAG_LEN 8       // 对角线模式从角出发的最大长度
+#define EVAL_MAX_LEN 10       // 模式的最大格子数，角区 3x3 为 9 格
+#define EVAL_MAX_PATTERNS 16  // 4 个角区、8 条边、4 条对角线
+#define EVAL_MAX_REFS 8       // 一个格子最多属于几个模式
+
+#ifndef USE_NNUE
+#define USE_NNUE 0 // 1 读到权重文件时位棋盘搜索用小型神经网络评估代替模式表和前沿子，0 不编译神经网络评估
+#endif
+#ifndef NNUE_FILE
+#define NNUE_FILE "data/nnue.bin" // 神经网络评估的权重文件，由 make train_nnue 生成，没有文件时仍用模式表
+#endif
+#define NNUE_VERSION 1                                  // 权重文件格式的版本号
+#define NNUE_VALUES 10                                  // 格子分数 0-9
+#define NNUE_RINGS 4                                    // 到边的距离 0-3，更远的格子与 3 相同
+#define NNUE_CLASSES (NNUE_RINGS * (NNUE_RINGS + 1) / 2) // 格子到上下边和左右边距离的无序对
+#define NNUE_FEATURES (3 * NNUE_VALUES * NNUE_CLASSES)  // 每个格子一个特征：状态（空、我方、对方）、分数、位置类别
+#define NNUE_HIDDEN 32                                  // 第一层（累加器）的宽度，16 的倍数
+#define NNUE_HIDDEN2 16                                 // 第二层的宽度
+#define NNUE_QA 255                                     // 激活值 1.0 对应的整数，累加器和第二层截断在 [0, NNUE_QA]
+#define NNUE_QB_SHIFT 6                                 // 第二层和输出层的权重 1.0 对应 2^6
+
+#ifndef FIXED_STRATEGY
+#define FIXED_STRATEGY -1 // 12x12 地图上角和稳定子系数的选择：-1 每局随机，0 或 1 固定，离线工具固定为 0 使结果可以复现
+#endif
+
+#ifndef TELEMETRY_FILE
+#define TELEMETRY_FILE "" // 每步搜索记录的输出文件，"" 不输出，"stderr" 输出到标准错误，不使用评测管道
+#endif
+
+#ifndef USE_PROFILE
+#define USE_PROFILE 0 // 1 统计热点函数的调用次数和周期数并写出剖析报告，0 不统计，插桩展开为空
+#endif
+#ifndef PROFILE_FILE
+#define PROFILE_FILE "log/profile.txt" // 剖析报告的输出文件，每步结束后在后台覆盖写入累计结果，"stderr" 只在进程退出时输出到标准错误
+#endif
+#define PROFILE_PLIES 32 // 剖析报告按层数分开统计，更深的层计入最后一层
+
+#if USE_PROFILE
+#include <mutex>
+#endif
+#if (USE_PROFILE || USE_NNUE) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+#ifndef USE_PONDER
+#define USE_PONDER 1 // 1 等待对方落子时在后台线程中搜索预测的局面，0 不后台搜索
+#endif
+#ifndef PONDER_MARGIN_MS
+#define PONDER_MARGIN_MS 5 // 后台搜索开启时每步少用的毫秒数：评测程序发来棋盘后，读棋盘的线程要先从后台搜索线程手里抢回 CPU
+#endif
+#if USE_PONDER && defined(__linux__)
+#include <pthread.h>
+#endif
+
+#ifndef USE_LMR
+#define USE_LMR 1 // 1 排序靠后的落子先减少深度搜索（late move reductions），0 所有落子同样深度
+#endif
+#ifndef USE_PROBCUT
+#define USE_PROBCUT 0 // 1 浅层搜索有把握预测深层搜索超出窗口时直接剪枝（ProbCut），0 不剪
+#endif
+
+#ifndef USE_MCTS
+#define USE_MCTS 0 // 1 位棋盘上用蒙特卡洛树搜索代替 pvsBits，0 使用 pvsBits
+#endif
+#ifndef MCTS_NODES
+#define MCTS_NODES (1 << 20) // 蒙特卡洛树节点池的节点数，在 init 中分配，用完后不再展开新节点
+#endif
+#define MCTS_ONE (1 << 16)      // 回报的定点表示，1.0 对应 MCTS_ONE
+#define MCTS_UCT_C 0.7          // UCT 公式中探索项的系数
+#define MCTS_EXPAND_VISITS 2    // 节点第几次被访问时展开
+#define MCTS_MARGIN_WEIGHT 0.2  // 回报中分差所占的比例，其余按胜负计
+
+#ifndef USE_MAILBOX
+#define USE_MAILBOX 1 // 1 在位棋盘放不下时使用带哨兵边框的一维棋盘搜索，0 直接使用 char 矩阵参考实现
+#endif
+
+#define MB_MAX_SIDE 24                                        // 一维棋盘支持的最大边长
+#define MB_MAX_CELLS ((MB_MAX_SIDE + 2) * (MB_MAX_SIDE + 2))   // 加上一圈哨兵后的最大格子数
+#define MB_MAX_FLIPS (8 * MB_MAX_SIDE)                        // 一步棋最多翻转的棋子数
+#define MB_LEGAL_OWN 0x00ff                                   // legal 中我方在八个方向上能否夹住棋子
+#define MB_LEGAL_OPP 0xff00                                   // legal 中对方在八个方向上能否夹住棋子
 
 using namespace std;
 
@@ -20,6 +158,586 @@ vector<vector<char>> init_mat; // 地图初始分数
 int general_score = 0;         // 地图总分数
 bool strategy;
 
+/**
+ * 一步棋的撤销记录，被翻转的格子存放在 flip_stack[flip_begin, flip_begin + flip_cnt)
+ */
+struct StepRecord
+{
+    int x, y;           // 落子位置
+    char old;           // 落子前的格子内容
+    bool myself;        // 是否我方下棋
+    int flip_begin;     // 翻转记录的起始位置
+    int flip_cnt;       // 翻转的格子数
+    int your_delta;     // 我方分数的变化量
+    int opponent_delta; // 对方分数的变化量
+};
+
+vector<StepRecord> step_stack; // doStep 的撤销栈，在 init 中分配好
+vector<int> flip_stack;        // 被翻转格子的下标 x * col_cnt + y
+int step_top = 0;              // 撤销栈的栈顶
+int flip_top = 0;              // 翻转记录的栈顶
+vector<Point> ply_points;      // 每层搜索的合法落子点缓冲区，第 depth 层从 depth * 格子数 开始
+
+/**
+ * 位棋盘，第 x 行第 y 列的格子对应下标 x * col_cnt + y
+ */
+struct Bits
+{
+    uint64_t w[BB_WORDS];
+};
+
+/**
+ * 位棋盘上的一个方向：左移或右移若干位，移位后与 mask 相与去掉越界和跨行的位
+ */
+struct BitDir
+{
+    int shift;
+    Bits mask;
+};
+
+/**
+ * evaluate 的各项，由 doStepBits 增量维护
+ */
+struct EvalTerms
+{
+    uint16_t pattern[EVAL_MAX_PATTERNS]; // 每个模式的三进制下标，格子为空 0、我方 1、对方 2
+    int pattern_score; // 所有模式的查表值之和
+    int frontier;   // getFrontier(board, 1) 的值
+    Bits front;     // 当前的前沿子
+#if USE_NNUE
+    int16_t accum[NNUE_HIDDEN]; // 神经网络第一层的累加器，从我方看，使用神经网络评估时代替以上各项
+    int psqt;                   // 每个格子的特征直接加到输出的线性部分之和，与 accum 一起维护
+#endif
+};
+
+/**
+ * 用位棋盘表示的棋局，own 为我方棋子，opp 为对方棋子
+ */
+struct BitBoard
+{
+    Bits own;
+    Bits opp;
+    int your_score;
+    int opponent_score;
+    uint64_t hash;  // 棋子分布的 Zobrist 哈希，不含轮到哪一方
+    EvalTerms eval; // 评估函数各项
+};
+
+/**
+ * 位棋盘走法生成的实现：三种 data 中出现的尺寸各有一个移位量为编译期常量、只处理用到的字的特化版本，
+ * 其他尺寸按用到的字数选一个移位量查 bit_dirs 的版本
+ */
+enum BitKernel
+{
+    KERNEL_ANY = 0,  // 任意尺寸，移位量和掩码查 bit_dirs，处理全部 BB_WORDS 个字
+    KERNEL_8 = 1,    // 8x8，1 个字
+    KERNEL_10 = 2,   // 10x10，2 个字
+    KERNEL_12 = 3,   // 12x12，3 个字
+    KERNEL_WORDS = 4 // 其他尺寸，移位量和掩码查 bit_dirs，只处理 bit_words 个字
+};
+
+bool bit_enabled = false;   // 当前地图能否使用位棋盘
+BitKernel bit_kernel = KERNEL_ANY; // 走法生成使用的实现，placeBits 每步按棋盘尺寸选一次
+int bit_rows = 0;           // 位棋盘行数
+int bit_cols = 0;           // 位棋盘列数
+int bit_words = BB_WORDS;   // 棋盘格子用到的字数
+Bits bit_full;              // 棋盘内所有格子
+Bits bit_blocked;           // 初始为数字 1-9 的格子，空着时会截断 isValid 的射线
+Bits bit_inner;             // 去掉最外一圈的格子，getFrontier 只统计这些格子
+Bits bit_score_plane[4];    // getScoreOfPoint 的分数按二进制位拆成的平面
+Bits bit_eval_plane[4];     // getScoreForEvaluate 的分数按二进制位拆成的平面
+Bits bit_valued;            // getScoreForEvaluate 分数不为 0 的格子，isFrontier 只看这些格子
+Bits bit_neighbors[BB_MAX_CELLS]; // 每个格子周围的八个格子
+BitDir bit_dirs[8];         // 前 4 个方向左移，后 4 个方向右移
+vector<int> bit_point_score; // 每个格子的 getScoreOfPoint 分数
+vector<int> bit_eval_score;  // 每个格子的 getScoreForEvaluate 分数
+
+/**
+ * 评估模式的种类，同一种类、同样长度的模式在模式表文件中共用一张表
+ */
+enum PatternType
+{
+    PATTERN_CORNER = 0, // 角附近的 3x3 格子，按 (行偏移 * 3 + 列偏移) 排列，对应 corner_weight
+    PATTERN_EDGE = 1,   // 从角出发沿边的格子，对应这个方向上的 steady_weight
+    PATTERN_DIAG = 2    // 从角出发沿对角线的格子，手写评估中没有这一项
+};
+
+/**
+ * 格子在某个模式中的位置，格子状态变化 k 时模式下标变化 k * pow3
+ */
+struct PatternRef
+{
+    uint8_t pattern; // 模式编号
+    uint16_t pow3;   // 格子对应的三进制位权
+};
+
+/**
+ * 模式表文件头，之后是 count 段，每段一个 EvalSection 加上 3^len 个 int32_t
+ */
+struct EvalHeader
+{
+    char magic[8];    // "CKEVAL\0\0"
+    uint32_t version; // EVAL_VERSION
+    uint32_t count;   // 段数
+};
+
+/**
+ * 模式表文件中一段的头：一种模式的拟合值，以 EVAL_FILE_SCALE 为 1，
+ * 使用时乘以模式格子的平均 getScoreForEvaluate 分数
+ */
+struct EvalSection
+{
+    uint32_t type; // PatternType
+    uint32_t len;  // 模式的格子数
+};
+
+int pow3[EVAL_MAX_LEN + 1];                         // 3 的幂
+int eval_pattern_cnt = 0;                           // 当前地图的模式个数
+int eval_pattern_type[EVAL_MAX_PATTERNS];           // 每个模式的种类
+int eval_pattern_len[EVAL_MAX_PATTERNS];            // 每个模式的格子数
+int eval_pattern_cells[EVAL_MAX_PATTERNS][EVAL_MAX_LEN]; // 每个模式的格子下标，从三进制最低位开始
+int eval_pattern_offset[EVAL_MAX_PATTERNS];         // 每个模式的值表在 eval_table 中的起始位置，格子分数相同的模式共用一张表
+int eval_active[EVAL_MAX_PATTERNS];                 // 值表不全为 0 的模式，只有这些模式参与评估和增量更新
+int eval_active_cnt = 0;                            // eval_active 的个数
+vector<int16_t> eval_table;                         // 所有模式的值表，手写评估折算的值加上模式表文件中的拟合值
+PatternRef eval_refs[BB_MAX_CELLS][EVAL_MAX_REFS];  // 每个格子所在的模式
+int eval_ref_cnt[BB_MAX_CELLS];                     // 每个格子所在的模式个数
+Bits bit_pattern_cells;                             // 属于某个模式的格子
+const EvalHeader *eval_file = NULL;                 // 映射到内存中的模式表文件，没有文件时为 NULL
+size_t eval_file_size = 0;                          // 模式表文件的长度
+
+#if USE_NNUE
+/**
+ * 神经网络评估的权重文件头，之后依次是：
+ * int16_t w1[NNUE_FEATURES][NNUE_HIDDEN]、int16_t b1[NNUE_HIDDEN]（以 NNUE_QA 为 1），
+ * int16_t wp[NNUE_FEATURES]（线性部分，与 b2 单位相同），
+ * int16_t w2[NNUE_HIDDEN2][NNUE_HIDDEN]（以 2^NNUE_QB_SHIFT 为 1）、int32_t b2[NNUE_HIDDEN2]（以 NNUE_QA * 2^NNUE_QB_SHIFT 为 1），
+ * int16_t w3[NNUE_HIDDEN2]、int32_t b3（与第二层相同）
+ */
+struct NnueHeader
+{
+    char magic[8];      // "CKNNUE\0\0"
+    uint32_t version;   // NNUE_VERSION
+    uint32_t features;  // NNUE_FEATURES
+    uint32_t hidden;    // NNUE_HIDDEN
+    uint32_t hidden2;   // NNUE_HIDDEN2
+    float out_scale;    // 输出层的整数结果乘以这个数得到手写评估的单位
+    uint32_t reserved;  // 0
+};
+
+/**
+ * 神经网络第一层之后的前向计算的实现，initNnue 按 CPU 支持的指令集选一次
+ */
+enum NnueKernel
+{
+    NNUE_SCALAR = 0, // 不使用 SIMD
+    NNUE_SSE2 = 1,   // 128 位 SSE2
+    NNUE_AVX2 = 2    // 256 位 AVX2
+};
+
+bool nnue_active = false;                 // 读到了权重文件，位棋盘搜索使用神经网络评估
+NnueKernel nnue_kernel = NNUE_SCALAR;     // 前向计算使用的实现
+const NnueHeader *nnue_file = NULL;       // 映射到内存中的权重文件，没有文件时为 NULL
+const int16_t *nnue_w1 = NULL;            // 以下是权重文件中各层的权重，直接指向映射的内存
+const int16_t *nnue_b1 = NULL;
+const int16_t *nnue_wp = NULL;
+const int16_t *nnue_w2 = NULL;
+const int32_t *nnue_b2 = NULL;
+const int16_t *nnue_w3 = NULL;
+const int32_t *nnue_b3 = NULL;
+int nnue_cell_feature[BB_MAX_CELLS];      // 每个格子为空时的特征下标，我方棋子加 1，对方棋子加 2
+#endif
+
+/**
+ * 位棋盘一步棋的撤销记录
+ */
+struct BitUndo
+{
+    Bits flips;         // 被翻转的棋子
+    int pos;            // 落子位置
+    bool myself;        // 是否我方下棋
+    int your_delta;     // 我方分数的变化量
+    int opponent_delta; // 对方分数的变化量
+    uint64_t hash_delta; // 哈希的变化量
+    EvalTerms eval;     // 落子前的评估项
+};
+
+//以 thread_local 声明的变量每个搜索线程各有一份
+thread_local BitUndo bit_undo[BB_MAX_CELLS]; // 位棋盘的撤销栈，每步棋占一个格子所以不会超过格子数
+thread_local int bit_undo_top = 0;           // 位棋盘撤销栈的栈顶
+
+typedef chrono::steady_clock search_clock;
+
+int time_limit_ms = TIME_LIMIT_MS;       // 每步搜索的时间上限
+int game_time_ms = GAME_TIME_MS;         // 整局搜索的总时间，0 表示不限制
+long long game_time_used = 0;            // 本局已经用掉的搜索时间（毫秒）
+search_clock::time_point search_deadline; // 本步搜索的截止时间
+atomic<bool> search_stop(false);         // 时间用完，所有线程正在进行的迭代作废
+thread_local long long search_nodes = 0; // 本线程本步搜索的节点数
+int time_check_mask = 1023;              // checkTime 每 time_check_mask + 1 个节点读一次时钟，由 initBits 按字数设置
+atomic<long long> helper_nodes(0);       // 辅助线程本步搜索的节点数之和
+int search_threads = SEARCH_THREADS;     // 搜索线程数，0 表示使用全部核心
+int depth_limit = MAX_PLY;               // 迭代加深的最大深度，测试固定深度时使用
+int move_cnt = 0;                        // 本局已经走了几步
+vector<int> depth_log;                   // 每一步完成的搜索深度，在 init 中分配好
+
+enum TTBound
+{
+    TT_EXACT = 0, // 准确值
+    TT_LOWER = 1, // 下界，发生了 beta 剪枝
+    TT_UPPER = 2  // 上界，没有走法超过 alpha
+};
+
+/**
+ * 置换表表项，16 字节，所有搜索线程共用且不加锁
+ * data 打包了得分、最优落子、深度和标志，key 存的是局面哈希与 data 的异或，
+ * 两个字被不同线程交错写入时异或校验不通过，读到的表项当作未命中
+ */
+struct TTEntry
+{
+    atomic<uint64_t> key;
+    atomic<uint64_t> data;
+};
+
+/**
+ * 从 TTEntry::data 解包出的内容
+ */
+struct TTData
+{
+    int score; // 搜索得分
+    int move;  // 最优落子位置，-1 表示没有
+    int depth; // 剩余搜索深度
+    int bound; // TTBound
+    int age;   // 写入时的搜索代数（低 6 位）
+};
+
+TTEntry *tt_table = NULL;            // 置换表，大小为 2 的幂
+uint64_t tt_mask = 0;                // 表项下标掩码
+uint8_t tt_age = 0;                  // 当前搜索代数，每次 place 加一
+uint64_t zobrist_own[BB_MAX_CELLS];  // 我方棋子的 Zobrist 键
+uint64_t zobrist_opp[BB_MAX_CELLS];  // 对方棋子的 Zobrist 键
+uint64_t zobrist_flip[BB_MAX_CELLS]; // 棋子被翻转时哈希的变化量
+uint64_t zobrist_side;               // 轮到对方下棋时异或上的键
+thread_local long long tt_probes = 0;     // 置换表查询次数
+thread_local long long tt_hits = 0;       // 查到同一局面的次数
+thread_local long long tt_cutoffs = 0;    // 直接用表项结果返回的次数
+thread_local long long tt_collisions = 0; // 表项被其他局面占用，或表中最优落子不合法的次数
+
+#define ORDER_HASH (1 << 30)   // 置换表中最优落子的排序分
+#define ORDER_KILLER (1 << 29) // 杀手落子的排序分，第二个杀手减一
+
+#define SEARCH_INF (1 << 30)    // 负极大值搜索的无穷大，取负不会溢出
+#define ASPIRATION_WINDOW 32    // 期望窗口的初始半宽，失败后每次加倍
+#define ASPIRATION_DEPTH 3      // 超过这个深度才使用期望窗口，浅层的得分还不稳定
+#define LMR_DEPTH 3             // 剩余深度不小于这个值时才减少
+#define LMR_MOVES 3             // 排序前几位的落子不减少
+#define LMR_LATE_MOVES 8        // 排序在这之后、剩余深度不小于 LMR_DEPTH + 2 时减少两层
+#define PROBCUT_MIN_DEPTH 3     // 剩余深度不小于这个值时才尝试 ProbCut
+#define PROBCUT_MAX_DEPTH 9     // probcut_fit 中拟合过的最大深度，更深的节点用这一行
+#define PROBCUT_T 1.0           // 浅层结果超出窗口这么多个标准差才剪枝
+
+thread_local int killer_moves[MAX_PLY][2];       // 每层最近引起剪枝的两个落子位置
+thread_local int history_table[2][BB_MAX_CELLS]; // 历史表，按轮到哪一方区分，剪枝时加 depth * depth
+int bit_order_score[BB_MAX_CELLS];               // 静态排序分：角、边、星位、格子分数
+thread_local long long search_cutoffs = 0;       // 发生剪枝的节点数
+thread_local long long search_first_cutoffs = 0; // 第一个落子就剪枝的节点数
+
+/**
+ * ProbCut 的线性模型：剩余深度 depth 的得分约为 a * 深度 depth - reduction 的得分 + b，残差的标准差为 sigma，
+ * 由 ./bin/fit --probcut 在 data 中的地图上拟合，不同地图的得分尺度相近，共用一组参数
+ */
+struct ProbCutFit
+{
+    int reduction; // 浅层搜索比 depth 少的层数，0 表示这个深度不做 ProbCut
+    double a;      // 斜率
+    double b;      // 截距
+    double sigma;  // 残差的标准差
+};
+
+//下标为剩余深度
+const ProbCutFit probcut_fit[PROBCUT_MAX_DEPTH + 1] = {
+    {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, {2, 1.016, 102.5, 645.1}, {2, 1.013, 169.9, 584.5},
+    {2, 1.025, -19.0, 557.0}, {2, 1.029, 75.9, 491.6}, {2, 1.015, -0.5, 503.5}, {2, 1.031, 29.5, 453.2}, {2, 1.037, -25.3, 410.0},
+};
+
+bool lmr_enabled = USE_LMR;                  // 是否减少排序靠后的落子的深度
+bool probcut_enabled = USE_PROBCUT;          // 是否使用 ProbCut
+thread_local long long lmr_reductions = 0;   // 减少深度搜索的落子数
+thread_local long long lmr_researches = 0;   // 减少深度后超过 alpha、按完整深度重搜的落子数
+thread_local long long probcut_cuts = 0;     // ProbCut 剪掉的节点数
+
+/**
+ * 终局哈希表表项，只在主线程中使用
+ * 上下界存的是终局分差减去当前分差，只由棋子分布和轮到哪一方决定，所以跨步保留
+ */
+struct EndEntry
+{
+    uint64_t key; // 局面哈希（含轮到哪一方）
+    int lower;    // 终局分差增量的下界
+    int upper;    // 终局分差增量的上界
+    int move;     // 最优落子位置，-1 表示没有
+};
+
+vector<EndEntry> end_table;              // 终局哈希表，在 init 中分配
+int endgame_empties = ENDGAME_EMPTIES;   // 开始精确求解的剩余空格数
+Bits bit_quadrant[4];                    // 棋盘按行列对半分成的四个区域，用于奇偶排序
+
+/**
+ * 开局库文件头，后面紧跟 count 个按 (map_key, pos_key) 升序排列的 BookEntry
+ */
+struct BookHeader
+{
+    char magic[8];    // "CKBOOK\0\0"
+    uint32_t version; // BOOK_VERSION
+    uint32_t count;   // 表项个数
+};
+
+/**
+ * 开局库表项，24 字节
+ */
+struct BookEntry
+{
+    uint64_t map_key; // 地图指纹，见 getMapKey
+    uint64_t pos_key; // 轮到我方下棋时位棋盘的 Zobrist 哈希
+    int32_t move;     // 落子位置的下标 x * col_cnt + y
+    int32_t depth;    // 生成时搜索到的深度
+};
+
+const BookEntry *book_table = NULL; // 映射到内存中的开局库表项，没有文件时为 NULL
+uint32_t book_cnt = 0;              // 开局库表项个数
+uint64_t book_map_key = 0;          // 当前地图的指纹
+bool book_active = false;           // 还没有出库，每步先查开局库
+
+bool ponder_enabled = USE_PONDER; // 是否在对方思考时后台搜索
+bool ponder_registered = false;   // 已经用 atexit 注册了 stopPonder
+thread ponder_thread;             // 后台搜索线程，place 返回前启动，下一次 place 开始时停止
+uint64_t ponder_key = 0;          // 后台搜索的局面哈希，轮到我方下棋
+int ponder_move = -1;             // 后台搜索最后一次完整迭代的最优落子位置
+int ponder_depth = 0;             // 后台搜索完成的深度，0 表示没有可用结果
+int ponder_score = 0;             // 后台搜索最后一次完整迭代的得分，作为下一层期望窗口的中心
+
+//每步的 place 运行在新建的线程中，thread_local 的排序表会丢失，跨步保留的搜索状态放在这里
+int game_history[2][BB_MAX_CELLS]; // 跨步保留的历史表，每步开始时减半
+int game_killers[MAX_PLY][2];      // 跨步保留的杀手落子，下标是相对于本步根节点的层数
+int game_pv[MAX_PLY];              // 上一步的主要变例，从我方落子开始，由置换表取出
+int game_pv_len = 0;               // 主要变例的长度
+BitBoard game_last;                // 上一步我方落子之后的局面
+bool game_last_valid = false;      // game_last 是否可用
+
+/**
+ * 一步搜索的统计，由各个 place 实现填写，place 返回前写成一行遥测记录
+ */
+struct SearchReport
+{
+    const char *source; // 落子来源：book、search、solve、mcts、mailbox、reference
+    int depth;          // 完成的搜索深度，终局求解时为剩余空格数，蒙特卡洛树搜索时为主要变例的长度
+    int score;          // 最优落子的得分，蒙特卡洛树搜索时为平均回报的千分数，INT_MIN 表示没有完成任何一层
+    bool ponder_hit;    // 是否用上了后台搜索的结果
+};
+
+SearchReport search_report;   // 本步搜索的统计
+FILE *telemetry_file = NULL;  // 遥测记录的输出，NULL 表示不输出
+
+#if USE_PROFILE
+/**
+ * 剖析的热点函数，计数包含被调用的函数（evaluate 包含 getStable 和 getFrontier，doStep 包含 Flip），
+ * PROF_PLACE 是整个 place，作为报告中占比的分母
+ */
+enum ProfileSection
+{
+    PROF_PLACE = 0,         // place
+    PROF_IS_VALID = 1,      // isValid
+    PROF_FLIP = 2,          // Flip
+    PROF_DO_STEP = 3,       // doStep
+    PROF_EVALUATE = 4,      // evaluate
+    PROF_STABLE = 5,        // getStable
+    PROF_FRONTIER = 6,      // getFrontier
+    PROF_COPY = 7,          // copyPlayer
+    PROF_FREE = 8,          // freePlayer
+    PROF_VALID_BITS = 9,    // getValidMask
+    PROF_FLIP_BITS = 10,    // getFlipMask
+    PROF_DO_STEP_BITS = 11, // doStepBits
+    PROF_DO_STEP_END = 12,  // doStepEnd，终局求解复制局面而不用撤销栈，计在开始求解的那一层
+    PROF_EVAL_BITS = 13,    // evaluateIncr
+    PROF_MOVES_MAIL = 14,   // getMailMoves
+    PROF_DO_STEP_MAIL = 15, // doStepMail
+    PROF_EVAL_MAIL = 16,    // evaluateMail
+    PROF_COUNT = 17
+};
+
+const char *profile_names[PROF_COUNT] = {
+    "place", "isValid", "Flip", "doStep", "evaluate", "getStable", "getFrontier", "copyPlayer", "freePlayer",
+    "getValidMask", "getFlipMask", "doStepBits", "doStepEnd", "evaluateIncr", "getMailMoves", "doStepMail",
+    "evaluateMail"};
+
+/**
+ * 剖析计数，按函数和层数（相对于本步根节点已经下了几步，即所在撤销栈的栈顶）分开
+ */
+struct ProfileCounts
+{
+    long long calls[PROF_COUNT][PROFILE_PLIES];  // 调用次数
+    long long cycles[PROF_COUNT][PROFILE_PLIES]; // 周期数
+};
+
+ProfileCounts profile_total;     // 已经并入的计数：退出的线程，以及每步结束时的 place 线程
+mutex profile_mutex;             // 保护 profile_total
+int profile_moves = 0;           // 已经统计的步数
+bool profile_registered = false; // 已经用 atexit 注册了 exitProfile
+thread profile_writer;           // 每步结束后在后台写剖析报告的线程
+
+//把 from 加到 to 上并把 from 清零
+inline void addProfile(ProfileCounts &to, ProfileCounts &from)
+{
+    for (int k = 0; k < PROF_COUNT; k++)
+    {
+        for (int ply = 0; ply < PROFILE_PLIES; ply++)
+        {
+            to.calls[k][ply] += from.calls[k][ply];
+            to.cycles[k][ply] += from.cycles[k][ply];
+        }
+    }
+    memset(&from, 0, sizeof(from));
+}
+
+//每个线程的计数不加锁累加，线程退出时并入 profile_total
+struct ProfileThread
+{
+    ProfileCounts counts;
+
+    ProfileThread()
+    {
+        memset(&counts, 0, sizeof(counts));
+    }
+
+    ~ProfileThread()
+    {
+        lock_guard<mutex> lock(profile_mutex);
+        addProfile(profile_total, counts);
+    }
+};
+
+thread_local ProfileThread profile_thread;
+
+//周期计数，x86 上读时间戳计数器，其他平台用纳秒代替
+inline uint64_t profileCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//作用域计时：构造时记下周期计数，析构时把经过的周期记到本线程的计数上
+struct ProfileScope
+{
+    int section;
+    int ply;
+    uint64_t start;
+
+    ProfileScope(int section, int ply)
+        : section(section), ply(min(max(ply, 0), PROFILE_PLIES - 1)), start(profileCycles())
+    {
+    }
+
+    ~ProfileScope()
+    {
+        profile_thread.counts.calls[section][ply]++;
+        profile_thread.counts.cycles[section][ply] += profileCycles() - start;
+    }
+};
+
+#define PROFILE_SCOPE(section, ply) ProfileScope profile_scope(section, ply)
+#else
+#define PROFILE_SCOPE(section, ply)
+#endif
+
+/**
+ * 蒙特卡洛树的节点，子节点在节点池中连续存放；节点只记录走到这里的一步，局面从根沿路径重走得到
+ */
+struct MctsNode
+{
+    atomic<int> visits;     // 访问次数，下降时就加一，回传之前相当于一次 0 回报的虚拟损失
+    atomic<long long> wins; // 累计回报，从走到这个节点的一方看，以 MCTS_ONE 为 1
+    atomic<int> state;      // MCTS_LEAF、MCTS_EXPANDING 或 MCTS_EXPANDED
+    int first_child;        // 第一个子节点在 mcts_nodes 中的下标
+    int child_cnt;          // 子节点个数，已展开且为 0 表示终局
+    int move;               // 走到这个节点的落子位置，-1 表示跳过
+    bool myself;            // 走到这个节点的一方是否我方
+};
+
+enum MctsState
+{
+    MCTS_LEAF = 0,      // 还没有展开
+    MCTS_EXPANDING = 1, // 某个线程正在展开，其他线程把它当作叶子
+    MCTS_EXPANDED = 2   // first_child 和 child_cnt 已经可用
+};
+
+bool mcts_enabled = USE_MCTS;   // 位棋盘上是否使用蒙特卡洛树搜索
+vector<MctsNode> mcts_nodes;    // 节点池，下标 0 是根节点，每步从头重新分配
+atomic<int> mcts_node_top(0);   // 节点池中下一个空闲节点
+
+//一维棋盘的格子内容，不小于 MB_DIGIT 的格子会截断 isValid 的射线
+enum MailCell
+{
+    MB_EMPTY = 0,  // 射线可以穿过的空格，例如初始为 '0' 的格子
+    MB_OWN = 1,    // 我方棋子 'O'
+    MB_OPP = 2,    // 对方棋子 'o'
+    MB_DIGIT = 3,  // 初始为数字 1-9 的空格
+    MB_BORDER = 4  // 棋盘外的哨兵
+};
+
+/**
+ * 带一圈哨兵的一维棋盘，第 x 行第 y 列的格子对应下标 (x + 1) * mail_stride + y + 1
+ * 12x12 的地图只用到 cell 和 legal 的前 196 项。
+ * legal 和 mobility 由 syncMailLegal 按落子和翻转的格子增量更新，撤销时恢复，生成落子和统计行动力都不需要扫描射线
+ */
+struct alignas(64) MailBoard
+{
+    int your_score;
+    int opponent_score;
+    int legal_ply;               // legal 和 mobility 已经包含撤销栈中前 legal_ply 步的改变
+    int mobility[2];             // 我方和对方的合法落子点个数
+    int8_t cell[MB_MAX_CELLS];
+    uint16_t legal[MB_MAX_CELLS]; // 空格向 mail_dir[d] 方向能为我方夹住棋子时第 d 位为 1，为对方时第 8 + d 位为 1
+};
+
+/**
+ * 一维棋盘一步棋的撤销记录，被翻转的格子存放在 mail_flips[flip_begin, flip_begin + flip_cnt)
+ */
+struct MailUndo
+{
+    int pos;            // 落子位置
+    int8_t old;         // 落子前的格子内容
+    bool myself;        // 是否我方下棋
+    int flip_begin;     // 翻转记录的起始位置
+    int flip_cnt;       // 翻转的格子数
+    int legal_begin;    // 在这一步同步 legal 时，修改记录的起始位置
+    int legal_ply;      // 在这一步同步 legal 时，同步前的 legal_ply
+    int mobility[2];    // 在这一步同步 legal 时，同步前双方的合法落子点个数
+    int your_delta;     // 我方分数的变化量
+    int opponent_delta; // 对方分数的变化量
+};
+
+bool mail_enabled = false;            // 当前地图能否使用一维棋盘
+int mail_rows = 0;                    // 棋盘行数
+int mail_cols = 0;                    // 棋盘列数
+int mail_stride = 0;                  // 一行的长度，等于列数加 2
+int mail_dir[8];                      // 八个方向在一维棋盘上的下标偏移
+vector<int> mail_cells;               // 棋盘内所有格子的下标，按静态排序分从高到低排列
+alignas(64) int8_t mail_point_score[MB_MAX_CELLS]; // 每个格子的 getScoreOfPoint 分数
+alignas(64) int8_t mail_eval_score[MB_MAX_CELLS];  // 每个格子的 getScoreForEvaluate 分数
+uint8_t mail_ray_dirs[MB_MAX_CELLS];  // 每个格子到棋盘边缘不少于 2 格、可能夹住对方棋子的方向
+MailUndo mail_undo[MAX_PLY + 1];      // 一维棋盘的撤销栈，搜索深度不超过 MAX_PLY
+int mail_undo_top = 0;                // 撤销栈的栈顶
+int mail_flips[(MAX_PLY + 1) * MB_MAX_FLIPS]; // 被翻转格子的下标
+int mail_flip_top = 0;                // 翻转记录的栈顶
+int mail_legal_pos[(MAX_PLY + 1) * MB_MAX_SIDE * MB_MAX_SIDE]; // 合法落子标记被修改的格子
+uint16_t mail_legal_old[(MAX_PLY + 1) * MB_MAX_SIDE * MB_MAX_SIDE]; // 同步前的标记
+int mail_legal_top = 0;               // 合法落子标记修改记录的栈顶
+unsigned mail_mark[MB_MAX_CELLS];     // 这一次同步已经记录过旧标记的格子等于 mail_mark_now
+unsigned mail_mark_now = 0;           // 每次 syncMailLegal 加一
+
 /**
  * 获取当前所在点的分数
  * @param[in] x 点的横坐标
@@ -60,6 +778,7 @@ int Flip(Player *player, int startX, int startY, int dirX, int dirY, bool myself
 
 /**
  * 进行落子操作并探索是否有符合的棋子可以被翻转，修改双方分数
+ * 同时把落子位置、被翻转的格子和分数变化压入撤销栈，之后可以用 undoStep 撤销
  * @param[in] player 玩家信息，包括棋盘现态，双方各自的分数
  * @param[in] stepX 落子的位置的横坐标
  * @param[in] stepY 落子的位置的纵坐标
@@ -68,6 +787,12 @@ int Flip(Player *player, int startX, int startY, int dirX, int dirY, bool myself
  */
 int doStep(Player *player, int stepX, int stepY, bool myself);
 
+/**
+ * 撤销最近一次 doStep，恢复棋盘和双方分数
+ * @param[in] player 玩家信息，必须是上一次 doStep 修改的棋局
+ */
+void undoStep(Player *player);
+
 Player *copyPlayer(Player *player);
 void freePlayer(Player *player);
 
@@ -131,365 +856,4011 @@ void init(Player *player);
  */
 Point place(Player *player);
 
-int getScoreOfPoint(int x, int y)
-{
-    char c = init_mat[x][y];
-    if (c == 'o' || c == 'O')
-    {
-        return 0;
-    }
-    else
-    {
-        return c - '0';
-    }
-}
+/**
+ * 根据初始地图建立位棋盘用到的掩码和分数平面，地图超过 BB_MAX_CELLS 个格子时不启用位棋盘
+ * @param[in] player 初始棋局的状态信息
+ */
+void initBits(Player *player);
 
-int getScoreForEvaluate(int x, int y)
-{
-    char c = init_mat[x][y];
-    if (c == 'o' || c == 'O')
-    {
-        return 1;
-    }
-    else
-    {
-        return c - '0';
-    }
-}
+/**
+ * 把 char 矩阵表示的棋局转换成位棋盘
+ * @param[in] player 当前棋局的状态信息
+ * @return 位棋盘表示的棋局
+ */
+BitBoard loadBits(Player *player);
 
-bool inMat(int x, int y, int row_cnt, int col_cnt)
-{
-    return (x >= 0 && x < row_cnt && y >= 0 && y < col_cnt);
-}
+/**
+ * 按棋盘尺寸选择走法生成的实现
+ * @param[in] rows 棋盘行数
+ * @param[in] cols 棋盘列数
+ * @return 8x8、10x10、12x12 返回对应的特化版本，其余返回 KERNEL_WORDS
+ */
+BitKernel selectKernel(int rows, int cols);
 
-int Flip(Player *player, int startX, int startY, int dirX, int dirY, bool myself)
-{
-    char myPiece = myself ? 'O' : 'o';          //判断这一步下的是哪种棋子
-    char opponentPiece = myself ? 'o' : 'O';
-    int x = startX + dirX;                      //向dir决定的方向进行一次探索
-    int y = startY + dirY;
-    int cnt = 0;                                //记录有多少个棋子被翻转
-    int cnt_score = 0;                          //记录翻转这些棋子的得分
-    bool valid = false;
-    
-    //如果探索到的在棋盘内部且是对手的棋子，记录得分并探索下一个棋子
-    while (inMat(x, y, player->row_cnt, player->col_cnt) && player->mat[x][y] == opponentPiece)
-    {
-        cnt++;                                  //被翻转的棋子加一
-        cnt_score += getScoreOfPoint(x, y);
-        x += dirX;
-        y += dirY;
-    }
+/**
+ * 求所有合法落子点，结果与对每个格子调用 isValid 一致，按 bit_kernel 分派到特化版本或通用版本
+ * @param[in] me 下棋方的棋子
+ * @param[in] op 另一方的棋子
+ * @return 合法落子点的集合
+ */
+Bits getValidMask(const Bits &me, const Bits &op);
 
-    //确保落子点仍然是我方棋子
-    if (inMat(x, y, player->row_cnt, player->col_cnt) && player->mat[x][y] == myPiece)
-    {
-        valid = true;
-    }
+/**
+ * getValidMask 的通用版本，移位量和掩码查 bit_dirs，处理全部 BB_WORDS 个字
+ */
+Bits getValidMaskAny(const Bits &me, const Bits &op);
 
-    //开始对记录在案的棋子进行翻转
-    if (valid && cnt > 0)
-    {
-        x = startX + dirX;                       //探索该方向上的下一个棋子
-        y = startY + dirY;
-        for (int i = 0; i < cnt; i++)            //翻转操作
-        {
-            player->mat[x][y] = myPiece;
-            x += dirX;
-            y += dirY;
-        }
-        return cnt_score;                        //返回除了落子点以外的得分
-    }
+/**
+ * getValidMask 在 data 中没有的尺寸上的版本，按 bit_words 选择只处理用到的字的实例，字数超过 9 时退回通用版本
+ */
+Bits getValidMaskByWords(const Bits &me, const Bits &op);
 
-    return 0;
+/**
+ * 求在 pos 落子后会被翻转的棋子，结果与八个方向上的 Flip 一致，按 bit_kernel 分派
+ * @param[in] me 下棋方的棋子
+ * @param[in] op 另一方的棋子
+ * @param[in] pos 落子位置的下标
+ * @return 被翻转棋子的集合
+ */
+Bits getFlipMask(const Bits &me, const Bits &op, int pos);
+
+/**
+ * getFlipMask 在 data 中没有的尺寸上的版本，与 getValidMaskByWords 相同
+ */
+Bits getFlipMaskByWords(const Bits &me, const Bits &op, int pos);
+
+/**
+ * getFlipMask 的通用版本
+ */
+Bits getFlipMaskAny(const Bits &me, const Bits &op, int pos);
+
+/**
+ * 位棋盘版本的 doStep
+ * @param[in] board 位棋盘表示的棋局
+ * @param[in] pos 落子位置的下标
+ * @param[in] myself true为我方下棋，false为对方下棋
+ * @return 返回这一步下棋方得到的分数（包含落子位置的得分）
+ */
+int doStepBits(BitBoard *board, int pos, bool myself);
+
+/**
+ * 撤销最近一次 doStepBits
+ * @param[in] board 位棋盘表示的棋局，必须是上一次 doStepBits 修改的棋局
+ */
+void undoStepBits(BitBoard *board);
+
+/**
+ * 位棋盘版本的 evaluate，从头计算模式下标后查表，再加上前沿子；
+ * 没有模式表文件时与 evaluate 一致，只是边长超过 EVAL_EDGE_LEN 时稳定子只数到这个长度
+ * @param[in] board 位棋盘表示的棋局
+ * @return 稳定子，角落点和前沿子的总评估分数
+ */
+int evaluateBits(const BitBoard &board);
+
+/**
+ * 手写评估中一个模式在给定状态下的值，即 getStable 中对应的 corner_weight 或一个方向上的 steady_weight 乘以系数
+ * @param[in] p 模式编号
+ * @param[in] index 模式的三进制下标
+ */
+int getPatternValue(int p, int index);
+
+/**
+ * 从头计算一个模式的三进制下标
+ * @param[in] board 位棋盘表示的棋局
+ * @param[in] p 模式编号
+ */
+int getPatternIndex(const BitBoard &board, int p);
+
+/**
+ * 把模式表文件映射到内存，只检查文件头和各段的长度，已经映射过时直接返回
+ * @param[in] path 模式表文件路径，"" 表示不使用
+ * @return true 映射成功
+ */
+bool loadEvalFile(const char *path);
+
+/**
+ * 在模式表文件中查找一种模式的拟合值
+ * @param[in] type 模式种类
+ * @param[in] len 模式的格子数
+ * @return 3^len 个拟合值，没有这一段时返回 NULL
+ */
+const int32_t *findEvalSection(int type, int len);
+
+/**
+ * 按当前地图建立所有模式：角区、边和对角线的格子，每个格子所在的模式，以及模式的值表
+ * 在 initBits 中调用，此时 strategy 已经确定
+ */
+void initPatterns();
+
+/**
+ * 从头计算 board->eval 的所有项
+ * @param[in] board 位棋盘表示的棋局
+ */
+void initEvalTerms(BitBoard *board);
+
+/**
+ * 用 doStepBits 维护的模式查表值之和加上前沿子，只需读两个整数；使用神经网络评估时从累加器做前向计算
+ * @param[in] board 位棋盘表示的棋局
+ * @return 与 evaluateBits 相同
+ */
+int evaluateIncr(const BitBoard &board);
+
+#if USE_NNUE
+/**
+ * 把权重文件映射到内存，检查文件头和长度，设置各层权重的指针；已经映射过时直接返回
+ * @param[in] path 权重文件路径
+ * @return true 映射成功
+ */
+bool loadNnueFile(const char *path);
+
+/**
+ * 按当前地图计算每个格子的特征下标，读取权重文件并选择前向计算的实现，在 initBits 中调用
+ */
+void initNnue();
+
+/**
+ * 局面中每个格子的特征下标，按格子下标顺序
+ * @param[in] board 位棋盘表示的棋局
+ * @param[in] swap 是否对调双方，即从对方看
+ * @param[out] features 至少 bit_rows * bit_cols 个元素
+ * @return 特征个数，即格子数
+ */
+int getNnueFeatures(const BitBoard &board, bool swap, int *features);
+
+/**
+ * 从头计算第一层的累加器和线性部分：b1 加上每个格子的特征在 w1 中的那一行，wp 中对应的值相加
+ * @param[in] board 位棋盘表示的棋局
+ * @param[out] eval 填写 accum 和 psqt
+ */
+void refreshNnue(const BitBoard &board, EvalTerms *eval);
+
+/**
+ * 从累加器开始的前向计算，第二层和输出层按 nnue_kernel 分派，三种实现的结果相同
+ * @param[in] eval 第一层的累加器和线性部分
+ * @return 从我方看的评估值，手写评估的单位
+ */
+int forwardNnue(const EvalTerms &eval);
+
+/**
+ * forwardNnue 中第二层和输出层不使用 SIMD 的实现，forwardNnueSse2 和 forwardNnueAvx2 与它的结果相同
+ * @param[in] accum 第一层的累加器
+ * @return 输出层的整数结果，不含线性部分
+ */
+int forwardNnueScalar(const int16_t *accum);
+#endif
+
+/**
+ * 位棋盘版本的主要变例搜索（负极大值形式），在同一个棋局上落子和撤销：
+ * 第一个落子用完整窗口，其余落子先用零窗口证明不比它好，失败时再用完整窗口重搜
+ * @param[in] board 位棋盘表示的棋局，返回时恢复原状
+ * @param[in] depth 当前搜索深度
+ * @param[in] alpha alpha值，用于剪枝操作，从轮到下棋的一方看
+ * @param[in] beta beta值，用于剪枝操作，从轮到下棋的一方看
+ * @param[in] nowPlayer 当前是否轮到玩家
+ * @return 从轮到下棋的一方看的得分，落在窗口外时是真实得分的界（fail-soft）
+ */
+int pvsBits(BitBoard &board, int depth, int alpha, int beta, bool nowPlayer);
+
+/**
+ * 给所有合法落子点打分，置换表落子最先，其次是本层的杀手落子，其余按历史表加静态排序分
+ * @param[in] moves 合法落子点的集合
+ * @param[in] tt_move 置换表中的最优落子，-1 表示没有
+ * @param[in] ply 距根节点的层数
+ * @param[in] nowPlayer 当前是否轮到玩家
+ * @param[out] list 落子位置
+ * @param[out] score 对应的排序分
+ * @return 落子点个数
+ */
+int orderMoves(Bits moves, int tt_move, int ply, bool nowPlayer, int *list, int *score);
+
+/**
+ * 把 list[i, cnt) 中排序分最高的落子换到第 i 个位置并返回
+ * @param[in] list 落子位置
+ * @param[in] score 对应的排序分
+ * @param[in] cnt 落子点个数
+ * @param[in] i 当前要取的位置
+ * @return 第 i 个要搜索的落子位置
+ */
+int pickMove(int *list, int *score, int cnt, int i);
+
+/**
+ * 记录引起剪枝的落子，更新杀手落子和历史表
+ * @param[in] pos 落子位置
+ * @param[in] ply 距根节点的层数
+ * @param[in] depth 剩余搜索深度
+ * @param[in] nowPlayer 当前是否轮到玩家
+ */
+void updateOrder(int pos, int ply, int depth, bool nowPlayer);
+
+/**
+ * 分配置换表并清空统计
+ * @param[in] size_mb 置换表大小（MB），向下取整到 2 的幂个表项
+ */
+void initTT(int size_mb);
+
+/**
+ * 查询置换表
+ * @param[in] key 局面哈希（含轮到哪一方）
+ * @param[out] out 命中时解包出的内容
+ * @return true 命中
+ */
+bool probeTT(uint64_t key, TTData *out);
+
+/**
+ * 写入置换表：空表项、同一局面、旧的搜索代数或深度不超过本次时覆盖
+ * @param[in] key 局面哈希（含轮到哪一方）
+ * @param[in] depth 剩余搜索深度
+ * @param[in] bound 边界类型
+ * @param[in] score 搜索得分
+ * @param[in] move 最优落子位置
+ */
+void storeTT(uint64_t key, int depth, TTBound bound, int score, int move);
+
+/**
+ * 计算本步的搜索时间：不超过 time_limit_ms，设置了整局时间时按剩余空格平分剩下的时间
+ * @param[in] empty_cnt 棋盘上剩余的空格数
+ * @return 本步可用的毫秒数
+ */
+int getTimeBudget(int empty_cnt);
+
+/**
+ * 每搜索一定数量的节点检查一次时钟，超过截止时间时设置 search_stop
+ * @return true 时间已用完
+ */
+bool checkTime();
+
+/**
+ * 按 list 的顺序搜索根节点的所有落子，第一个落子用 [alpha, beta] 窗口，其余落子用零窗口，
+ * 比目前最好的落子好时再用完整窗口重搜
+ * @param[in] board 位棋盘表示的棋局，返回时恢复原状
+ * @param[in] list 根节点的落子位置
+ * @param[in] cnt 落子点个数
+ * @param[in] depth 搜索深度，包含根节点这一步
+ * @param[in] alpha 根节点窗口的下界
+ * @param[in] beta 根节点窗口的上界
+ * @param[out] best_index 最优落子在 list 中的下标
+ * @return 最优落子的得分，不在 (alpha, beta) 内时只是一个界，search_stop 被设置时无意义
+ */
+int searchRoot(BitBoard &board, int *list, int cnt, int depth, int alpha, int beta, int *best_index);
+
+/**
+ * 以上一层的得分为中心用期望窗口搜索根节点，得分落在窗口外时把那一侧放宽一倍后重搜
+ * @param[in] board 位棋盘表示的棋局，返回时恢复原状
+ * @param[in] list 根节点的落子位置
+ * @param[in] cnt 落子点个数
+ * @param[in] depth 搜索深度，包含根节点这一步
+ * @param[in] guess 上一层的得分，INT_MIN 表示没有，此时用完整窗口
+ * @param[out] best_index 最优落子在 list 中的下标
+ * @return 最优落子的得分，search_stop 被设置时无意义
+ */
+int searchAspiration(BitBoard &board, int *list, int cnt, int depth, int guess, int *best_index);
+
+/**
+ * Lazy SMP 辅助线程：与主线程搜索同一个根节点，奇数号线程多搜一层，
+ * 只通过共享的置换表影响主线程，直到 search_stop 被设置
+ * @param[in] board 根节点棋局的副本
+ * @param[in] list 主线程排好序的根节点落子，启动线程前复制，主线程随后会重排自己的数组
+ * @param[in] max_depth 最大搜索深度
+ * @param[in] id 线程编号，从 1 开始
+ */
+void helperSearch(BitBoard board, vector<int> list, int max_depth, int id);
+
+/**
+ * 终局求解用的落子：只更新棋子、分数和哈希，不维护评估项也不记录撤销信息，
+ * 由调用方保存落子前的棋局并恢复
+ * @param[in] board 位棋盘表示的棋局
+ * @param[in] pos 落子位置的下标
+ * @param[in] myself true为我方下棋，false为对方下棋
+ */
+void doStepEnd(BitBoard *board, int pos, bool myself);
+
+/**
+ * 给终局求解的落子打分：哈希表落子最先；空格多时对方行动力少的优先（fastest-first）；
+ * 落在剩余空格为奇数的区域的优先；其余按静态排序分
+ * @param[in] board 位棋盘表示的棋局
+ * @param[in] moves 合法落子点的集合
+ * @param[in] hash_move 终局哈希表中的最优落子，-1 表示没有
+ * @param[in] nowPlayer 当前是否轮到玩家
+ * @param[in] empties 剩余空格数
+ * @param[out] list 落子位置
+ * @param[out] score 对应的排序分
+ * @return 落子点个数
+ */
+int orderEndMoves(const BitBoard &board, Bits moves, int hash_move, bool nowPlayer, int empties, int *list, int *score);
+
+/**
+ * 精确求解终局分差 your_score - opponent_score，一方无子可下时由另一方继续，双方都不能下时终局
+ * @param[in] board 位棋盘表示的棋局，返回时恢复原状
+ * @param[in] alpha alpha值，用于剪枝操作
+ * @param[in] beta beta值，用于剪枝操作
+ * @param[in] nowPlayer 当前是否轮到玩家
+ * @param[in] empties 剩余空格数
+ * @return 终局分差，search_stop 被设置时无意义
+ */
+int solveBits(BitBoard &board, int alpha, int beta, bool nowPlayer, int empties);
+
+/**
+ * 按 list 的顺序精确求解根节点的所有落子
+ * @param[in] board 位棋盘表示的棋局，返回时恢复原状
+ * @param[in] list 根节点的落子位置
+ * @param[in] cnt 落子点个数
+ * @param[in] empties 剩余空格数
+ * @param[out] best_index 最优落子在 list 中的下标
+ * @return 最优落子的终局分差，search_stop 被设置时无意义
+ */
+int solveRoot(BitBoard &board, int *list, int cnt, int empties, int *best_index);
+
+/**
+ * 计算地图指纹：对行数、列数和初始棋盘的每个格子做 FNV-1a 哈希，
+ * 我方先手和后手、棋子颜色对调后看到的地图指纹不同
+ * @param[in] player 初始棋局的状态信息
+ */
+uint64_t getMapKey(Player *player);
+
+/**
+ * 把开局库文件映射到内存，只检查文件头和长度，不解析也不复制表项
+ * 已经映射过时直接返回
+ * @param[in] path 开局库文件路径
+ * @return true 映射成功
+ */
+bool loadBook(const char *path);
+
+/**
+ * 在开局库中二分查找当前地图的局面
+ * @param[in] pos_key 轮到我方下棋时位棋盘的 Zobrist 哈希
+ * @return 落子位置的下标，未命中时返回 -1
+ */
+int probeBook(uint64_t pos_key);
+
+/**
+ * 把跨步保留的历史表和杀手落子复制到本线程的排序表
+ * @param[in] shift 本线程根节点比保存时的根节点深几层，杀手落子按层数平移
+ */
+void loadSearchState(int shift);
+
+/**
+ * 判断当前局面是否是上一步我方落子再加上对方一步应对后的局面
+ * @param[in] board 轮到我方下棋的当前局面
+ * @return 对方应对的落子位置，不是这样的后继（包括对方无子可下）时返回 -1
+ */
+int findReply(const BitBoard &board);
+
+/**
+ * 本步搜索结束后保存主线程的历史表和杀手落子，并从置换表中取出以本步落子开始的主要变例
+ * @param[in] board 本步落子前的局面
+ * @param[in] pos 本步落子位置的下标
+ */
+void saveSearchState(const BitBoard &board, int pos);
+
+/**
+ * 后台搜索线程：对轮到我方的局面逐层加深，直到 search_stop 或搜完 max_depth 层，
+ * 每完成一层更新 ponder_move 和 ponder_depth，结果同时留在共用的置换表中
+ * @param[in] board 预测对方落子之后的局面
+ * @param[in] max_depth 最大搜索深度
+ */
+void ponderSearch(BitBoard board, int max_depth);
+
+/**
+ * 在 place 返回前启动后台搜索：按置换表中的最优应对预测对方落子，搜索之后轮到我方的局面
+ * 对方无子可下、我方随后无子可下或已进入终局求解时不启动
+ * @param[in] board 本步落子前的局面
+ * @param[in] pos 本步落子位置的下标
+ */
+void startPonder(const BitBoard &board, int pos);
+
+/**
+ * 停止后台搜索并等待线程退出，没有后台搜索时直接返回
+ */
+void stopPonder();
+
+/**
+ * 从节点池中分配并填好 node 的子节点：每个合法落子一个；无子可下而对方可下时一个跳过节点；都无子可下时没有子节点
+ * 节点池不够时把 node 恢复为叶子
+ * @param[in] node 已由调用方置为 MCTS_EXPANDING 的节点
+ * @param[in] board 节点对应的局面
+ * @return 是否展开成功
+ */
+bool expandMcts(MctsNode &node, const BitBoard &board);
+
+/**
+ * 按 UCT 公式选择子节点，还没有访问过的子节点最先选择
+ * @param[in] node 已展开且有子节点的节点
+ * @return 子节点相对于 first_child 的序号
+ */
+int selectMcts(const MctsNode &node);
+
+/**
+ * 双方随机落子直到终局，按最终分数计算我方的回报
+ * @param[in] board 开始随机对局的局面，按值传入
+ * @param[in] nowPlayer 是否轮到我方下棋
+ * @param[in,out] rng 本线程的随机数状态
+ * @return 我方的回报，胜负占 1 - MCTS_MARGIN_WEIGHT，分差占 MCTS_MARGIN_WEIGHT，以 MCTS_ONE 为 1
+ */
+int playoutMcts(BitBoard board, bool nowPlayer, uint64_t &rng);
+
+/**
+ * 蒙特卡洛树搜索的工作线程：反复选择、展开、随机对局、回传，直到 search_stop
+ * @param[in] root 根节点对应的局面
+ * @param[in] id 线程编号，主线程为 0
+ */
+void mctsSearch(BitBoard root, int id);
+
+/**
+ * 位棋盘上的蒙特卡洛树搜索版本的 place，与 placeBits 使用相同的每步时间预算，
+ * 返回根节点访问次数最多的落子点
+ * @param[in] player 当前棋局的状态信息
+ */
+Point placeMcts(Player *player);
+
+/**
+ * 把本步的 search_report 和搜索计数器写成一行 JSON，每行写完立即 fflush，进程被杀掉时已写的记录不丢
+ * nodes 包括辅助线程，tt_hit、cutoff 和 first_cutoff 只统计主线程，不随线程数变化
+ * @param[in] point 本步的落子点
+ * @param[in] us 本步的总用时（微秒）
+ */
+void writeTelemetry(Point point, long long us);
+
+#if USE_PROFILE
+/**
+ * 写出剖析报告：函数按总周期数从大到小排列，每个函数之后是各层的调用次数和周期数，
+ * 占比以所有 place 的总周期数为分母；函数之间互相包含，辅助线程和后台搜索线程的周期也计入各函数，占比之和可以超过 100%
+ * @param[in] file 输出文件
+ */
+void writeProfile(FILE *file);
+
+/**
+ * 把剖析报告写到 PROFILE_FILE：文件每次覆盖写入，进程被杀掉时保留上一步的累计结果；"stderr" 时写到标准错误
+ * 每步结束时由 profile_writer 在后台调用，不占用这一步的时间
+ */
+void saveProfile();
+
+/**
+ * 进程退出时调用：等 profile_writer 写完后再写一次。在 stopPonder 之后运行，
+ * 后台搜索线程已经停止并且并入了计数，报告即整局的结果
+ */
+void exitProfile();
+#endif
+
+/**
+ * char 矩阵参考实现的 place，固定深度 MAX_DEPTH 的 alphaBeta
+ * @param[in] player 当前棋局的状态信息
+ */
+Point placeMatrix(Player *player);
+
+/**
+ * 位棋盘版本的 place，开局库命中时直接返回；剩余空格不多时先精确求解终局，
+ * 否则从 1 层开始逐层加深直到时间用完，返回主线程最后一次完整搜索的最优落子点
+ * @param[in] player 当前棋局的状态信息
+ */
+Point placeBits(Player *player);
+
+/**
+ * 格子的静态排序分：角最好，紧挨角的 C 位和星位最差，其余边次之，再加上格子本身的分数
+ * @param[in] x 点的横坐标
+ * @param[in] y 点的纵坐标
+ * @param[in] rows 棋盘行数
+ * @param[in] cols 棋盘列数
+ */
+int getOrderScore(int x, int y, int rows, int cols);
+
+/**
+ * 根据初始地图建立一维棋盘用到的分数表、方向偏移和射线方向表
+ * @param[in] player 初始棋局的状态信息
+ */
+void initMail(Player *player);
+
+/**
+ * 把 char 矩阵表示的棋局转换成一维棋盘，哨兵格子填 MB_BORDER，从头计算 legal 并清空撤销栈
+ * @param[in] player 当前棋局的状态信息
+ * @param[out] board 一维棋盘表示的棋局
+ */
+void loadMail(Player *player, MailBoard *board);
+
+/**
+ * 一维棋盘上一个格子的估值，与 evaluate 中 board[i][j] 的值相同，空格和哨兵为 0
+ * @param[in] board 一维棋盘表示的棋局
+ * @param[in] pos 格子的下标
+ */
+int getMailValue(const MailBoard &board, int pos);
+
+/**
+ * 一维棋盘版本的 isValid，读取 legal，调用前 legal 必须已经同步
+ * @param[in] board 一维棋盘表示的棋局
+ * @param[in] pos 落子位置的下标
+ * @param[in] nowPlayer 当前是否轮到玩家
+ */
+bool isValidMail(const MailBoard &board, int pos, bool nowPlayer);
+
+/**
+ * 从头计算一个空格的 legal，沿射线走到哨兵或数字格子为止，不做越界判断
+ * @param[in] board 一维棋盘表示的棋局
+ * @param[in] pos 空格的下标
+ */
+uint16_t getMailLegal(const MailBoard &board, int pos);
+
+/**
+ * 让 legal 和 mobility 包含撤销栈中所有落子的改变，只重新计算射线经过落子和翻转格子的空格。
+ * 搜索到叶子时不需要合法落子，所以 doStepMail 不做这一步，等到生成落子或者取行动力时才补上
+ * @param[in] board 一维棋盘表示的棋局
+ */
+void syncMailLegal(MailBoard *board);
+
+/**
+ * 一方的合法落子点个数，先同步 legal
+ * @param[in] board 一维棋盘表示的棋局
+ * @param[in] nowPlayer 是否为我方
+ */
+int getMailMobility(MailBoard &board, bool nowPlayer);
+
+/**
+ * 落子或翻转改变了 changed 之后，重新计算射线经过它的空格在这个方向上的 legal，
+ * 每个方向走到双方的棋子都出现过为止：更远的空格向 changed 的射线在这之前已经被某一方的棋子截断
+ * @param[in] board 一维棋盘表示的棋局
+ * @param[in] changed 改变的格子
+ */
+void updateMailLegal(MailBoard *board, int changed);
+
+/**
+ * 先同步 legal，再按 mail_cells 的顺序列出一方的合法落子点
+ * @param[in] board 一维棋盘表示的棋局
+ * @param[in] nowPlayer 当前是否轮到玩家
+ * @param[out] list 合法落子点的下标
+ * @return 合法落子点的个数
+ */
+int getMailMoves(MailBoard &board, bool nowPlayer, int *list);
+
+/**
+ * 一维棋盘版本的 doStep，记录撤销信息，legal 留给 syncMailLegal 更新
+ * @param[in] board 一维棋盘表示的棋局
+ * @param[in] pos 落子位置的下标
+ * @param[in] myself true为我方下棋，false为对方下棋
+ * @return 返回这一步下棋方得到的分数（包含落子位置的得分）
+ */
+int doStepMail(MailBoard *board, int pos, bool myself);
+
+/**
+ * 撤销最近一次 doStepMail
+ * @param[in] board 一维棋盘表示的棋局，必须是上一次 doStepMail 修改的棋局
+ */
+void undoStepMail(MailBoard *board);
+
+/**
+ * 一维棋盘版本的 evaluate，结果与 evaluateBits 一致
+ * @param[in] board 一维棋盘表示的棋局
+ * @return 稳定子，角落点和前沿子的总评估分数
+ */
+int evaluateMail(const MailBoard &board);
+
+/**
+ * 一维棋盘版本的 alphaBeta，按静态排序分搜索落子
+ * @param[in] board 一维棋盘表示的棋局，返回时恢复原状
+ * @param[in] depth 当前搜索深度
+ * @param[in] alpha alpha值，用于剪枝操作
+ * @param[in] beta beta值，用于剪枝操作
+ * @param[in] nowPlayer 当前是否轮到玩家
+ */
+int alphaBetaMail(MailBoard &board, int depth, int alpha, int beta, bool nowPlayer);
+
+/**
+ * 一维棋盘版本的 place，单线程迭代加深，用于位棋盘放不下的地图
+ * @param[in] player 当前棋局的状态信息
+ */
+Point placeMail(Player *player);
+
+int getScoreOfPoint(int x, int y)
+{
+    char c = init_mat[x][y];
+    if (c == 'o' || c == 'O')
+    {
+        return 0;
+    }
+    else
+    {
+        return c - '0';
+    }
+}
+
+int getScoreForEvaluate(int x, int y)
+{
+    char c = init_mat[x][y];
+    if (c == 'o' || c == 'O')
+    {
+        return 1;
+    }
+    else
+    {
+        return c - '0';
+    }
+}
+
+bool inMat(int x, int y, int row_cnt, int col_cnt)
+{
+    return (x >= 0 && x < row_cnt && y >= 0 && y < col_cnt);
+}
+
+int Flip(Player *player, int startX, int startY, int dirX, int dirY, bool myself)
+{
+    PROFILE_SCOPE(PROF_FLIP, step_top);
+    char myPiece = myself ? 'O' : 'o';          //判断这一步下的是哪种棋子
+    char opponentPiece = myself ? 'o' : 'O';
+    int x = startX + dirX;                      //向dir决定的方向进行一次探索
+    int y = startY + dirY;
+    int cnt = 0;                                //记录有多少个棋子被翻转
+    int cnt_score = 0;                          //记录翻转这些棋子的得分
+    bool valid = false;
+    
+    //如果探索到的在棋盘内部且是对手的棋子，记录得分并探索下一个棋子
+    while (inMat(x, y, player->row_cnt, player->col_cnt) && player->mat[x][y] == opponentPiece)
+    {
+        cnt++;                                  //被翻转的棋子加一
+        cnt_score += getScoreOfPoint(x, y);
+        x += dirX;
+        y += dirY;
+    }
+
+    //确保落子点仍然是我方棋子
+    if (inMat(x, y, player->row_cnt, player->col_cnt) && player->mat[x][y] == myPiece)
+    {
+        valid = true;
+    }
+
+    //开始对记录在案的棋子进行翻转
+    if (valid && cnt > 0)
+    {
+        x = startX + dirX;                       //探索该方向上的下一个棋子
+        y = startY + dirY;
+        for (int i = 0; i < cnt; i++)            //翻转操作
+        {
+            player->mat[x][y] = myPiece;
+            assert(flip_top < (int)flip_stack.size());
+            flip_stack[flip_top++] = x * player->col_cnt + y; //记录被翻转的格子，供 undoStep 恢复
+            x += dirX;
+            y += dirY;
+        }
+        return cnt_score;                        //返回除了落子点以外的得分
+    }
+
+    return 0;
+}
+
+int doStep(Player *player, int stepX, int stepY, bool myself)
+{
+    PROFILE_SCOPE(PROF_DO_STEP, step_top);
+    char myPiece = myself ? 'O' : 'o';           //判断这一步下的是哪种棋子
+    //undoStep 总是出栈，这里也总是入栈，栈满说明调用方没有配对撤销
+    assert(step_top < (int)step_stack.size());
+    StepRecord &rec = step_stack[step_top];
+    rec.x = stepX;
+    rec.y = stepY;
+    rec.old = player->mat[stepX][stepY];
+    rec.myself = myself;
+    rec.flip_begin = flip_top;
+    player->mat[stepX][stepY] = myPiece;         //在落子位置放上我方棋子
+
+    int directions[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+
+    int score = 0;
+
+    //向落子的八个方向探索，并进行翻转
+    for (int i = 0; i < 8; i++)
+    {
+        score += Flip(player, stepX, stepY, directions[i][0], directions[i][1], myself);
+    }
+
+    int point_score = getScoreOfPoint(stepX, stepY);//获取落子点的分数
+
+    int your_delta = myself ? score + point_score : -score;
+    int opponent_delta = myself ? -score : score + point_score;
+    player->your_score += your_delta;
+    player->opponent_score += opponent_delta;
+
+    rec.flip_cnt = flip_top - rec.flip_begin;
+    rec.your_delta = your_delta;
+    rec.opponent_delta = opponent_delta;
+    step_top++;
+    return score + point_score;
+}
+
+void undoStep(Player *player)
+{
+    StepRecord &rec = step_stack[--step_top];
+    char opponentPiece = rec.myself ? 'o' : 'O';
+    for (int i = rec.flip_begin; i < rec.flip_begin + rec.flip_cnt; i++)
+    {
+        player->mat[flip_stack[i] / player->col_cnt][flip_stack[i] % player->col_cnt] = opponentPiece;
+    }
+    flip_top = rec.flip_begin;
+    player->mat[rec.x][rec.y] = rec.old;
+    player->your_score -= rec.your_delta;
+    player->opponent_score -= rec.opponent_delta;
+}
+
+Player *copyPlayer(Player *player)
+{
+    PROFILE_SCOPE(PROF_COPY, step_top);
+    Player *new_player = new Player;
+    new_player->row_cnt = player->row_cnt;
+    new_player->col_cnt = player->col_cnt;
+    new_player->your_score = player->your_score;
+    new_player->opponent_score = player->opponent_score;
+
+    new_player->mat = new char *[new_player->row_cnt];
+    for (int i = 0; i < new_player->row_cnt; i++)
+    {
+        new_player->mat[i] = new char[new_player->col_cnt];
+        memcpy(new_player->mat[i], player->mat[i], new_player->col_cnt * sizeof(char));
+    }
+
+    return new_player;
+}
+
+void freePlayer(Player *player)
+{
+    PROFILE_SCOPE(PROF_FREE, step_top);
+    for (int i = 0; i < player->row_cnt; i++)
+    {
+        delete[] player->mat[i];
+    }
+    delete[] player->mat;
+    delete player;
+}
+
+bool isValid(Player *player, int posX, int posY, bool nowPlayer)
+{
+    PROFILE_SCOPE(PROF_IS_VALID, step_top);
+    if (posX < 0 || posX >= player->row_cnt || posY < 0 || posY >= player->col_cnt)
+    {
+        return false;
+    }
+    if (player->mat[posX][posY] == 'o' || player->mat[posX][posY] == 'O')
+    {
+        return false;
+    }
+    static const int step[8][2] = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}, {1, 1}, {-1, -1}, {1, -1}, {-1, 1}};
+    for (int i = 0; i < 8; ++i)
+    {
+        int dx = step[i][0];
+        int dy = step[i][1];
+        int x = posX + dx;
+        int y = posY + dy;
+        if (x < 0 || x >= player->row_cnt || y < 0 || y >= player->col_cnt)
+        {
+            continue;
+        }
+        if ((nowPlayer && player->mat[x][y] != 'o') || (!nowPlayer && player->mat[x][y] != 'O'))
+        {
+            continue;
+        }
+        while (true)
+        {
+            x += dx;
+            y += dy;
+            if (x < 0 || x >= player->row_cnt || y < 0 || y >= player->col_cnt || (player->mat[x][y] >= '1' && player->mat[x][y] <= '9'))
+            {
+                break;
+            }
+            if ((nowPlayer && player->mat[x][y] == 'O') || (!nowPlayer && player->mat[x][y] == 'o'))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+int getStable(vector<vector<int>> &board, int w_weight)
+{
+    PROFILE_SCOPE(PROF_STABLE, step_top);
+    int n = board.size();
+    int corner_weight = 0;
+    int steady_weight = 0;
+
+    //行数和列数可以不同
+    int row = n - 1;
+    int col = board[0].size() - 1;
+    vector<vector<int>> corner_map = {
+        {0, 0, 1, 1},
+        {0, col, 1, -1},
+        {row, 0, -1, 1},
+        {row, col, -1, -1}};
+
+    for (auto &corner_data : corner_map)
+    {
+        int corner_x = corner_data[0];
+        int corner_y = corner_data[1];
+        int dy = corner_data[2];
+        int dx = corner_data[3];
+
+        if (board[corner_x][corner_y] == 0)
+        {
+            corner_weight += board[corner_x][corner_y + dx] * w_weight * -3;
+            corner_weight += board[corner_x + dy][corner_y] * w_weight * -3;
+            corner_weight += board[corner_x + dy][corner_y + dx] * w_weight * -6;
+
+            corner_weight += board[corner_x][corner_y + 2 * dx] * w_weight * 4;
+            corner_weight += board[corner_x + 2 * dy][corner_y] * w_weight * 4;
+            corner_weight += board[corner_x + dy][corner_y + 2 * dx] * w_weight * 2;
+            corner_weight += board[corner_x + 2 * dy][corner_y + dx] * w_weight * 2;
+        }
+        else
+        {
+            int i = corner_x;
+            int j = corner_y;
+            int current_score = board[corner_x][corner_y];
+
+            corner_weight += board[corner_x][corner_y] * w_weight * 15;
+
+            while (i >= 0 && i <= row && board[i][corner_y] == current_score)
+            {
+                steady_weight += w_weight * current_score;
+                i += dy;
+            }
+            while (j >= 0 && j <= col && board[corner_x][j] == current_score)
+            {
+                steady_weight += w_weight * current_score;
+                j += dx;
+            }
+        }
+    }
+    if (n == 8)
+        return 14 * corner_weight + 12 * steady_weight;
+    else if (n == 10)
+        return 14 * corner_weight + 12 * steady_weight;
+    else if (n == 12 && strategy)
+        return 12 * corner_weight + 14 * steady_weight;
+    else
+        return 14 * corner_weight + 12 * steady_weight;
+}
+
+bool isFrontier(vector<vector<int>> &board, int i, int j)
+{
+    for (int dy = -1; dy <= 1; dy++)
+    {
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            if (!(dy == 0 && dx == 0) && board[i + dy][j + dx] != 0)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+int getFrontier(vector<vector<int>> &board, int w_weight)
+{
+    PROFILE_SCOPE(PROF_FRONTIER, step_top);
+    int rows = board.size();
+    int cols = board[0].size();
+    int frontier_weight = 0;
+
+    for (int i = 1; i <= rows - 2; i++)
+    {
+        for (int j = 1; j <= cols - 2; j++)
+        {
+            if (board[i][j] != 0 && isFrontier(board, i, j))
+            {
+                frontier_weight -= board[i][j] * w_weight;
+            }
+        }
+    }
+    return frontier_weight;
+}
+
+int evaluate(Player *player)
+{
+    PROFILE_SCOPE(PROF_EVALUATE, step_top);
+    vector<vector<int>> board(player->row_cnt, vector<int>(player->col_cnt, 0));
+    for (int i = 0; i < player->row_cnt; i++)
+    {
+        for (int j = 0; j < player->col_cnt; j++)
+        {
+            if (player->mat[i][j] == 'O')
+            {
+                board[i][j] = getScoreForEvaluate(i, j);
+            }
+            else if (player->mat[i][j] == 'o')
+            {
+                board[i][j] = -getScoreForEvaluate(i, j);
+            }
+        }
+    }
+
+    int player_score = getStable(board, 1) + 4 * getFrontier(board, 1);
+    return player_score;
+}
+
+int alphaBeta(Player *player, int depth, int alpha, int beta, bool nowPlayer)
+{
+    search_nodes++;
+    Point *valid_points = &ply_points[depth * player->row_cnt * player->col_cnt];
+    int valid_cnt = 0;
+    for (int i = 0; i < player->row_cnt; i++)
+    {
+        for (int j = 0; j < player->col_cnt; j++)
+        {
+            if (isValid(player, i, j, nowPlayer))
+            {
+                valid_points[valid_cnt++] = initPoint(i, j);
+            }
+        }
+    }
+    if (depth == 0)
+    {
+        return evaluate(player);
+    }
+
+    if (valid_cnt == 0)
+    {
+        return evaluate(player);
+    }
+
+    if (nowPlayer)
+    {
+        for (int i = 0; i < valid_cnt; ++i)
+        {
+            doStep(player, valid_points[i].X, valid_points[i].Y, 1);
+            int score = alphaBeta(player, depth - 1, alpha, beta, false);
+            undoStep(player);
+
+            alpha = max(alpha, score);
+
+            if (beta <= alpha)
+            {
+                return beta;
+            }
+        }
+        return alpha;
+    }
+    else
+    {
+        for (int i = 0; i < valid_cnt; ++i)
+        {
+            doStep(player, valid_points[i].X, valid_points[i].Y, 0);
+            int score = alphaBeta(player, depth - 1, alpha, beta, true);
+            undoStep(player);
+
+            beta = min(beta, score);
+
+            if (beta <= alpha)
+            {
+                return alpha;
+            }
+        }
+        return beta;
+    }
+}
+
+inline Bits operator&(const Bits &a, const Bits &b)
+{
+    Bits r;
+    for (int i = 0; i < BB_WORDS; i++)
+        r.w[i] = a.w[i] & b.w[i];
+    return r;
+}
+
+inline Bits operator|(const Bits &a, const Bits &b)
+{
+    Bits r;
+    for (int i = 0; i < BB_WORDS; i++)
+        r.w[i] = a.w[i] | b.w[i];
+    return r;
+}
+
+inline Bits operator~(const Bits &a)
+{
+    Bits r;
+    for (int i = 0; i < BB_WORDS; i++)
+        r.w[i] = ~a.w[i];
+    return r;
+}
+
+inline Bits &operator|=(Bits &a, const Bits &b)
+{
+    for (int i = 0; i < BB_WORDS; i++)
+        a.w[i] |= b.w[i];
+    return a;
+}
+
+inline Bits &operator&=(Bits &a, const Bits &b)
+{
+    for (int i = 0; i < BB_WORDS; i++)
+        a.w[i] &= b.w[i];
+    return a;
+}
+
+inline bool bitAny(const Bits &a)
+{
+    uint64_t r = 0;
+    for (int i = 0; i < BB_WORDS; i++)
+        r |= a.w[i];
+    return r != 0;
+}
+
+inline bool bitTest(const Bits &a, int pos)
+{
+    return (a.w[pos >> 6] >> (pos & 63)) & 1;
+}
+
+inline void bitSet(Bits &a, int pos)
+{
+    a.w[pos >> 6] |= (uint64_t)1 << (pos & 63);
+}
+
+inline Bits bitSingle(int pos)
+{
+    Bits r = {};
+    bitSet(r, pos);
+    return r;
+}
+
+inline int bitCount(const Bits &a)
+{
+    int cnt = 0;
+    for (int i = 0; i < BB_WORDS; i++)
+        cnt += __builtin_popcountll(a.w[i]);
+    return cnt;
+}
+
+//取出并清除最低位的下标，按下标从小到大就是 valid_points 的行优先顺序
+inline int bitPop(Bits &a)
+{
+    for (int i = 0; i < BB_WORDS; i++)
+    {
+        if (a.w[i])
+        {
+            int pos = (i << 6) + __builtin_ctzll(a.w[i]);
+            a.w[i] &= a.w[i] - 1;
+            return pos;
+        }
+    }
+    return -1;
+}
+
+//整体左移 k 位（0 < k < 64），高位字接住低位字移出的位
+inline Bits bitShl(const Bits &a, int k)
+{
+    Bits r;
+    for (int i = BB_WORDS - 1; i > 0; i--)
+        r.w[i] = (a.w[i] << k) | (a.w[i - 1] >> (64 - k));
+    r.w[0] = a.w[0] << k;
+    return r;
+}
+
+//整体右移 k 位（0 < k < 64）
+inline Bits bitShr(const Bits &a, int k)
+{
+    Bits r;
+    for (int i = 0; i < BB_WORDS - 1; i++)
+        r.w[i] = (a.w[i] >> k) | (a.w[i + 1] << (64 - k));
+    r.w[BB_WORDS - 1] = a.w[BB_WORDS - 1] >> k;
+    return r;
+}
+
+//沿方向 dir 移动一格，LEFT 必须与 dir < 4 一致，这样循环内没有分支
+template <bool LEFT>
+inline Bits bitStep(const Bits &a, int dir)
+{
+    const BitDir &d = bit_dirs[dir];
+    return (LEFT ? bitShl(a, d.shift) : bitShr(a, d.shift)) & d.mask;
+}
+
+inline Bits bitShift(const Bits &a, int dir)
+{
+    return dir < 4 ? bitStep<true>(a, dir) : bitStep<false>(a, dir);
+}
+
+//按二进制位平面求一组格子的分数之和
+inline int bitWeight(const Bits &a, const Bits *plane)
+{
+    return bitCount(a & plane[0]) + 2 * bitCount(a & plane[1]) + 4 * bitCount(a & plane[2]) + 8 * bitCount(a & plane[3]);
+}
+
+//逐个格子累加分数，适合只有几个格子的集合
+inline int bitSum(Bits a, const int *score)
+{
+    int sum = 0;
+    while (bitAny(a))
+    {
+        sum += score[bitPop(a)];
+    }
+    return sum;
+}
+
+int getOrderScore(int x, int y, int rows, int cols)
+{
+    int dx = min(x, rows - 1 - x);
+    int dy = min(y, cols - 1 - y);
+    int order = 20 * getScoreOfPoint(x, y);
+    if (dx == 0 && dy == 0)
+        order += 800;
+    else if (dx == 1 && dy == 1)
+        order -= 400;
+    else if ((dx == 0 && dy == 1) || (dx == 1 && dy == 0))
+        order -= 200;
+    else if (dx == 0 || dy == 0)
+        order += 100;
+    return order;
+}
+
+void initBits(Player *player)
+{
+    int rows = player->row_cnt;
+    int cols = player->col_cnt;
+    time_check_mask = 1023;
+    bit_enabled = rows >= 3 && cols >= 3 && rows * cols <= BB_MAX_CELLS;
+    if (!bit_enabled)
+    {
+        return;
+    }
+    bit_rows = rows;
+    bit_cols = cols;
+    bit_words = (rows * cols + 63) / 64;
+    //字数越多每个节点越慢，每多一倍检查间隔减半，使两次读时钟之间的时间与 12x12 相近
+    for (int words = bit_words; words > 3; words = (words + 1) / 2)
+    {
+        time_check_mask >>= 1;
+    }
+    bit_kernel = selectKernel(rows, cols);
+    bit_point_score.assign(rows * cols, 0);
+    bit_eval_score.assign(rows * cols, 0);
+
+    Bits first_col = {}, last_col = {};
+    bit_full = bit_blocked = bit_inner = Bits();
+    for (int k = 0; k < 4; k++)
+    {
+        bit_score_plane[k] = bit_eval_plane[k] = Bits();
+    }
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            int pos = i * cols + j;
+            char c = init_mat[i][j];
+            bitSet(bit_full, pos);
+            if (j == 0)
+                bitSet(first_col, pos);
+            if (j == cols - 1)
+                bitSet(last_col, pos);
+            if (i > 0 && i < rows - 1 && j > 0 && j < cols - 1)
+                bitSet(bit_inner, pos);
+            if (c >= '1' && c <= '9')
+                bitSet(bit_blocked, pos);
+
+            bit_point_score[pos] = getScoreOfPoint(i, j);
+            bit_eval_score[pos] = getScoreForEvaluate(i, j);
+            for (int k = 0; k < 4; k++)
+            {
+                if ((bit_point_score[pos] >> k) & 1)
+                    bitSet(bit_score_plane[k], pos);
+                if ((bit_eval_score[pos] >> k) & 1)
+                    bitSet(bit_eval_plane[k], pos);
+            }
+        }
+    }
+
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            bit_order_score[i * cols + j] = getOrderScore(i, j, rows, cols);
+        }
+    }
+    memset(history_table, 0, sizeof(history_table));
+
+    //固定种子，不同进程中同一局面的哈希相同
+    mt19937_64 zobrist_gen(20240716);
+    for (int pos = 0; pos < BB_MAX_CELLS; pos++)
+    {
+        zobrist_own[pos] = zobrist_gen();
+        zobrist_opp[pos] = zobrist_gen();
+        zobrist_flip[pos] = zobrist_own[pos] ^ zobrist_opp[pos];
+    }
+    zobrist_side = zobrist_gen();
+
+    bit_valued = bit_eval_plane[0] | bit_eval_plane[1] | bit_eval_plane[2] | bit_eval_plane[3];
+
+    for (int q = 0; q < 4; q++)
+    {
+        bit_quadrant[q] = Bits();
+    }
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            bitSet(bit_quadrant[(i >= rows / 2) * 2 + (j >= cols / 2)], i * cols + j);
+        }
+    }
+
+    //左移：右、下、右下、左下；右移：左、上、左上、右上
+    Bits not_first = bit_full & ~first_col;
+    Bits not_last = bit_full & ~last_col;
+    int shifts[8] = {1, cols, cols + 1, cols - 1, 1, cols, cols + 1, cols - 1};
+    Bits masks[8] = {not_first, bit_full, not_first, not_last, not_last, bit_full, not_last, not_first};
+    for (int d = 0; d < 8; d++)
+    {
+        bit_dirs[d].shift = shifts[d];
+        bit_dirs[d].mask = masks[d];
+    }
+    for (int pos = 0; pos < rows * cols; pos++)
+    {
+        bit_neighbors[pos] = Bits();
+        for (int d = 0; d < 8; d++)
+        {
+            bit_neighbors[pos] |= bitShift(bitSingle(pos), d);
+        }
+    }
+    initPatterns();
+#if USE_NNUE
+    initNnue();
+#endif
+}
+
+BitBoard loadBits(Player *player)
+{
+    BitBoard board = {};
+    for (int i = 0; i < player->row_cnt; i++)
+    {
+        for (int j = 0; j < player->col_cnt; j++)
+        {
+            int pos = i * bit_cols + j;
+            if (player->mat[i][j] == 'O')
+            {
+                bitSet(board.own, pos);
+                board.hash ^= zobrist_own[pos];
+            }
+            else if (player->mat[i][j] == 'o')
+            {
+                bitSet(board.opp, pos);
+                board.hash ^= zobrist_opp[pos];
+            }
+        }
+    }
+    board.your_score = player->your_score;
+    board.opponent_score = player->opponent_score;
+    initEvalTerms(&board);
+    return board;
+}
+
+//从我方棋子出发逆着射线方向扩展，最后一格必须是紧挨落子点的对方棋子
+template <bool LEFT>
+inline Bits getValidDir(const Bits &me, const Bits &op, const Bits &pass, int dir)
+{
+    Bits t = bitStep<LEFT>(me, dir) & pass;
+    Bits x = t;
+    while (bitAny(x))
+    {
+        x = bitStep<LEFT>(x, dir) & pass;
+        t |= x;
+    }
+    return bitStep<LEFT>(t & op, dir);
+}
+
+Bits getValidMaskAny(const Bits &me, const Bits &op)
+{
+    Bits empty = bit_full & ~(me | op);
+    //isValid 的射线只在数字格截断，其他空格和对方棋子一样可以穿过
+    Bits pass = op | (empty & ~bit_blocked);
+    Bits moves = {};
+    for (int d = 0; d < 4; d++)
+    {
+        moves |= getValidDir<true>(me, op, pass, d);
+    }
+    for (int d = 4; d < 8; d++)
+    {
+        moves |= getValidDir<false>(me, op, pass, d);
+    }
+    return moves & empty;
+}
+
+//沿方向 dir 连续的对方棋子，末端是我方棋子时全部翻转
+template <bool LEFT>
+inline void getFlipDir(const Bits &me, const Bits &op, const Bits &start, int dir, Bits &flips)
+{
+    Bits x = bitStep<LEFT>(start, dir) & op;
+    Bits t = x;
+    while (bitAny(x))
+    {
+        x = bitStep<LEFT>(x, dir);
+        if (bitAny(x & me))
+        {
+            flips |= t;
+            return;
+        }
+        x &= op;
+        t |= x;
+    }
+}
+
+Bits getFlipMaskAny(const Bits &me, const Bits &op, int pos)
+{
+    Bits start = bitSingle(pos);
+    Bits flips = {};
+    for (int d = 0; d < 4; d++)
+    {
+        getFlipDir<true>(me, op, start, d, flips);
+    }
+    for (int d = 4; d < 8; d++)
+    {
+        getFlipDir<false>(me, op, start, d, flips);
+    }
+    return flips;
+}
+
+/**
+ * 只有前 W 个字的位棋盘，特化的走法生成在它上面运算，循环次数和移位量都是编译期常量
+ */
+template <int W>
+struct BitsW
+{
+    uint64_t w[W];
+
+    static BitsW load(const Bits &a)
+    {
+        BitsW r;
+        for (int i = 0; i < W; i++)
+            r.w[i] = a.w[i];
+        return r;
+    }
+
+    Bits store() const
+    {
+        Bits r = {};
+        for (int i = 0; i < W; i++)
+            r.w[i] = w[i];
+        return r;
+    }
+
+    BitsW operator&(const BitsW &b) const
+    {
+        BitsW r;
+        for (int i = 0; i < W; i++)
+            r.w[i] = w[i] & b.w[i];
+        return r;
+    }
+
+    BitsW operator|(const BitsW &b) const
+    {
+        BitsW r;
+        for (int i = 0; i < W; i++)
+            r.w[i] = w[i] | b.w[i];
+        return r;
+    }
+
+    BitsW operator~() const
+    {
+        BitsW r;
+        for (int i = 0; i < W; i++)
+            r.w[i] = ~w[i];
+        return r;
+    }
+
+    bool any() const
+    {
+        uint64_t r = 0;
+        for (int i = 0; i < W; i++)
+            r |= w[i];
+        return r != 0;
+    }
+};
+
+//沿方向移动一格：LEFT 为整体左移 K 位，否则右移 K 位，再与掩码相与
+template <int W, bool LEFT, int K>
+inline BitsW<W> bitStepSized(const BitsW<W> &a, const BitsW<W> &mask)
+{
+    BitsW<W> r;
+    if (LEFT)
+    {
+        for (int i = W - 1; i > 0; i--)
+            r.w[i] = (a.w[i] << K) | (a.w[i - 1] >> (64 - K));
+        r.w[0] = a.w[0] << K;
+    }
+    else
+    {
+        for (int i = 0; i < W - 1; i++)
+            r.w[i] = (a.w[i] >> K) | (a.w[i + 1] << (64 - K));
+        r.w[W - 1] = a.w[W - 1] >> K;
+    }
+    return r & mask;
+}
+
+template <int W, bool LEFT, int K>
+inline BitsW<W> getValidDirSized(const BitsW<W> &me, const BitsW<W> &op, const BitsW<W> &pass, const Bits &mask_bits)
+{
+    BitsW<W> mask = BitsW<W>::load(mask_bits);
+    BitsW<W> t = bitStepSized<W, LEFT, K>(me, mask) & pass;
+    BitsW<W> x = t;
+    while (x.any())
+    {
+        x = bitStepSized<W, LEFT, K>(x, mask) & pass;
+        t = t | x;
+    }
+    return bitStepSized<W, LEFT, K>(t & op, mask);
+}
+
+template <int W, bool LEFT, int K>
+inline void getFlipDirSized(const BitsW<W> &me, const BitsW<W> &op, const BitsW<W> &start, const Bits &mask_bits, BitsW<W> &flips)
+{
+    BitsW<W> mask = BitsW<W>::load(mask_bits);
+    BitsW<W> x = bitStepSized<W, LEFT, K>(start, mask) & op;
+    BitsW<W> t = x;
+    while (x.any())
+    {
+        x = bitStepSized<W, LEFT, K>(x, mask);
+        if ((x & me).any())
+        {
+            flips = flips | t;
+            return;
+        }
+        x = x & op;
+        t = t | x;
+    }
+}
+
+//方向顺序与 bit_dirs 相同：左移 1、COLS、COLS + 1、COLS - 1，右移同样四个
+//flatten 让八个方向全部内联，-O2 下 W = 3 不内联时比通用版本还慢
+template <int W, int COLS>
+__attribute__((flatten)) Bits getValidMaskSized(const Bits &me_bits, const Bits &op_bits)
+{
+    typedef BitsW<W> B;
+    B me = B::load(me_bits);
+    B op = B::load(op_bits);
+    B empty = B::load(bit_full) & ~(me | op);
+    B pass = op | (empty & ~B::load(bit_blocked));
+    B moves = getValidDirSized<W, true, 1>(me, op, pass, bit_dirs[0].mask) |
+              getValidDirSized<W, true, COLS>(me, op, pass, bit_dirs[1].mask) |
+              getValidDirSized<W, true, COLS + 1>(me, op, pass, bit_dirs[2].mask) |
+              getValidDirSized<W, true, COLS - 1>(me, op, pass, bit_dirs[3].mask) |
+              getValidDirSized<W, false, 1>(me, op, pass, bit_dirs[4].mask) |
+              getValidDirSized<W, false, COLS>(me, op, pass, bit_dirs[5].mask) |
+              getValidDirSized<W, false, COLS + 1>(me, op, pass, bit_dirs[6].mask) |
+              getValidDirSized<W, false, COLS - 1>(me, op, pass, bit_dirs[7].mask);
+    return (moves & empty).store();
+}
+
+template <int W, int COLS>
+__attribute__((flatten)) Bits getFlipMaskSized(const Bits &me_bits, const Bits &op_bits, int pos)
+{
+    typedef BitsW<W> B;
+    B me = B::load(me_bits);
+    B op = B::load(op_bits);
+    B start = B::load(bitSingle(pos));
+    B flips = B::load(Bits());
+    getFlipDirSized<W, true, 1>(me, op, start, bit_dirs[0].mask, flips);
+    getFlipDirSized<W, true, COLS>(me, op, start, bit_dirs[1].mask, flips);
+    getFlipDirSized<W, true, COLS + 1>(me, op, start, bit_dirs[2].mask, flips);
+    getFlipDirSized<W, true, COLS - 1>(me, op, start, bit_dirs[3].mask, flips);
+    getFlipDirSized<W, false, 1>(me, op, start, bit_dirs[4].mask, flips);
+    getFlipDirSized<W, false, COLS>(me, op, start, bit_dirs[5].mask, flips);
+    getFlipDirSized<W, false, COLS + 1>(me, op, start, bit_dirs[6].mask, flips);
+    getFlipDirSized<W, false, COLS - 1>(me, op, start, bit_dirs[7].mask, flips);
+    return flips.store();
+}
+
+//与 bitStepSized 相同，只是移位量 k 在运行时给出，0 < k < 64
+template <int W, bool LEFT>
+inline BitsW<W> bitStepWords(const BitsW<W> &a, int k, const BitsW<W> &mask)
+{
+    BitsW<W> r;
+    if (LEFT)
+    {
+        for (int i = W - 1; i > 0; i--)
+            r.w[i] = (a.w[i] << k) | (a.w[i - 1] >> (64 - k));
+        r.w[0] = a.w[0] << k;
+    }
+    else
+    {
+        for (int i = 0; i < W - 1; i++)
+            r.w[i] = (a.w[i] >> k) | (a.w[i + 1] << (64 - k));
+        r.w[W - 1] = a.w[W - 1] >> k;
+    }
+    return r & mask;
+}
+
+template <int W, bool LEFT>
+inline BitsW<W> getValidDirWords(const BitsW<W> &me, const BitsW<W> &op, const BitsW<W> &pass, const BitDir &dir)
+{
+    BitsW<W> mask = BitsW<W>::load(dir.mask);
+    BitsW<W> t = bitStepWords<W, LEFT>(me, dir.shift, mask) & pass;
+    BitsW<W> x = t;
+    while (x.any())
+    {
+        x = bitStepWords<W, LEFT>(x, dir.shift, mask) & pass;
+        t = t | x;
+    }
+    return bitStepWords<W, LEFT>(t & op, dir.shift, mask);
+}
+
+template <int W, bool LEFT>
+inline void getFlipDirWords(const BitsW<W> &me, const BitsW<W> &op, const BitsW<W> &start, const BitDir &dir, BitsW<W> &flips)
+{
+    BitsW<W> mask = BitsW<W>::load(dir.mask);
+    BitsW<W> x = bitStepWords<W, LEFT>(start, dir.shift, mask) & op;
+    BitsW<W> t = x;
+    while (x.any())
+    {
+        x = bitStepWords<W, LEFT>(x, dir.shift, mask);
+        if ((x & me).any())
+        {
+            flips = flips | t;
+            return;
+        }
+        x = x & op;
+        t = t | x;
+    }
+}
+
+//data 中没有的尺寸（例如 13x13 或长方形）只处理用到的 W 个字，比 getValidMaskAny 少做 BB_WORDS - W 个字
+template <int W>
+__attribute__((flatten)) Bits getValidMaskWords(const Bits &me_bits, const Bits &op_bits)
+{
+    typedef BitsW<W> B;
+    B me = B::load(me_bits);
+    B op = B::load(op_bits);
+    B empty = B::load(bit_full) & ~(me | op);
+    B pass = op | (empty & ~B::load(bit_blocked));
+    B moves = B::load(Bits());
+    for (int d = 0; d < 4; d++)
+    {
+        moves = moves | getValidDirWords<W, true>(me, op, pass, bit_dirs[d]);
+    }
+    for (int d = 4; d < 8; d++)
+    {
+        moves = moves | getValidDirWords<W, false>(me, op, pass, bit_dirs[d]);
+    }
+    return (moves & empty).store();
+}
+
+template <int W>
+__attribute__((flatten)) Bits getFlipMaskWords(const Bits &me_bits, const Bits &op_bits, int pos)
+{
+    typedef BitsW<W> B;
+    B me = B::load(me_bits);
+    B op = B::load(op_bits);
+    B start = B::load(bitSingle(pos));
+    B flips = B::load(Bits());
+    for (int d = 0; d < 4; d++)
+    {
+        getFlipDirWords<W, true>(me, op, start, bit_dirs[d], flips);
+    }
+    for (int d = 4; d < 8; d++)
+    {
+        getFlipDirWords<W, false>(me, op, start, bit_dirs[d], flips);
+    }
+    return flips.store();
+}
+
+//字数超过 BB_WORDS 的分支不会执行，模板参数取较小值只为能够编译
+#define BB_WORDS_CASE(W, call) \
+    case W:                    \
+        return call<(W < BB_WORDS ? W : BB_WORDS)>
+
+Bits getValidMaskByWords(const Bits &me, const Bits &op)
+{
+    switch (bit_words)
+    {
+        BB_WORDS_CASE(1, getValidMaskWords)(me, op);
+        BB_WORDS_CASE(2, getValidMaskWords)(me, op);
+        BB_WORDS_CASE(3, getValidMaskWords)(me, op);
+        BB_WORDS_CASE(4, getValidMaskWords)(me, op);
+        BB_WORDS_CASE(5, getValidMaskWords)(me, op);
+        BB_WORDS_CASE(6, getValidMaskWords)(me, op);
+        BB_WORDS_CASE(7, getValidMaskWords)(me, op);
+        BB_WORDS_CASE(8, getValidMaskWords)(me, op);
+        BB_WORDS_CASE(9, getValidMaskWords)(me, op);
+    default:
+        return getValidMaskAny(me, op);
+    }
+}
+
+Bits getFlipMaskByWords(const Bits &me, const Bits &op, int pos)
+{
+    switch (bit_words)
+    {
+        BB_WORDS_CASE(1, getFlipMaskWords)(me, op, pos);
+        BB_WORDS_CASE(2, getFlipMaskWords)(me, op, pos);
+        BB_WORDS_CASE(3, getFlipMaskWords)(me, op, pos);
+        BB_WORDS_CASE(4, getFlipMaskWords)(me, op, pos);
+        BB_WORDS_CASE(5, getFlipMaskWords)(me, op, pos);
+        BB_WORDS_CASE(6, getFlipMaskWords)(me, op, pos);
+        BB_WORDS_CASE(7, getFlipMaskWords)(me, op, pos);
+        BB_WORDS_CASE(8, getFlipMaskWords)(me, op, pos);
+        BB_WORDS_CASE(9, getFlipMaskWords)(me, op, pos);
+    default:
+        return getFlipMaskAny(me, op, pos);
+    }
+}
+
+BitKernel selectKernel(int rows, int cols)
+{
+    if (rows == 8 && cols == 8)
+        return KERNEL_8;
+    if (rows == 10 && cols == 10)
+        return KERNEL_10;
+    //12x12 用满 3 个字，特化版本单独的翻转不比通用版本快，但走法生成和整个搜索的每秒结点数更高
+    if (rows == 12 && cols == 12)
+        return KERNEL_12;
+    return KERNEL_WORDS;
+}
+
+//bit_kernel 每步只设置一次，这里的分支总能预测正确，特化版本可以内联进调用方
+Bits getValidMask(const Bits &me, const Bits &op)
+{
+    PROFILE_SCOPE(PROF_VALID_BITS, bit_undo_top);
+    switch (bit_kernel)
+    {
+    case KERNEL_8:
+        return getValidMaskSized<1, 8>(me, op);
+    case KERNEL_10:
+        return getValidMaskSized<2, 10>(me, op);
+    case KERNEL_12:
+        return getValidMaskSized<3, 12>(me, op);
+    case KERNEL_WORDS:
+        return getValidMaskByWords(me, op);
+    default:
+        return getValidMaskAny(me, op);
+    }
+}
+
+Bits getFlipMask(const Bits &me, const Bits &op, int pos)
+{
+    PROFILE_SCOPE(PROF_FLIP_BITS, bit_undo_top);
+    switch (bit_kernel)
+    {
+    case KERNEL_8:
+        return getFlipMaskSized<1, 8>(me, op, pos);
+    case KERNEL_10:
+        return getFlipMaskSized<2, 10>(me, op, pos);
+    case KERNEL_12:
+        return getFlipMaskSized<3, 12>(me, op, pos);
+    case KERNEL_WORDS:
+        return getFlipMaskByWords(me, op, pos);
+    default:
+        return getFlipMaskAny(me, op, pos);
+    }
+}
+
+//格子 pos 的三进制数字变化 delta（落子为 1 或 2，翻转为 -1 或 1），更新它所在各个模式的下标和 pattern_score
+inline void updatePatterns(EvalTerms *eval, int pos, int delta)
+{
+    for (int r = 0; r < eval_ref_cnt[pos]; r++)
+    {
+        const PatternRef &ref = eval_refs[pos][r];
+        const int16_t *table = &eval_table[eval_pattern_offset[ref.pattern]];
+        eval->pattern_score -= table[eval->pattern[ref.pattern]];
+        eval->pattern[ref.pattern] += delta * ref.pow3;
+        eval->pattern_score += table[eval->pattern[ref.pattern]];
+    }
+}
+
+#if USE_NNUE
+//累加器中一个格子的特征从 from 换成 to：减去 w1 的第 from 行，加上第 to 行，循环由编译器向量化
+inline void updateNnue(EvalTerms *eval, int from, int to)
+{
+    const int16_t *sub = &nnue_w1[from * NNUE_HIDDEN];
+    const int16_t *add = &nnue_w1[to * NNUE_HIDDEN];
+    for (int k = 0; k < NNUE_HIDDEN; k++)
+    {
+        eval->accum[k] = (int16_t)(eval->accum[k] + add[k] - sub[k]);
+    }
+    eval->psqt += nnue_wp[to] - nnue_wp[from];
+}
+#endif
+
+int doStepBits(BitBoard *board, int pos, bool myself)
+{
+    PROFILE_SCOPE(PROF_DO_STEP_BITS, bit_undo_top);
+    Bits &me = myself ? board->own : board->opp;
+    Bits &op = myself ? board->opp : board->own;
+    Bits flips = getFlipMask(me, op, pos);
+    EvalTerms old_eval = board->eval;
+    me |= flips;
+    bitSet(me, pos);
+    op &= ~flips;
+
+    //落子的格子从 0 变为 1 或 2，被翻转的格子在 1 和 2 之间互换，只改动这些格子所在模式的下标和查表值
+    EvalTerms &eval = board->eval;
+#if USE_NNUE
+    if (nnue_active)
+    {
+        //神经网络评估只用累加器，同样只加减改变了状态的格子的那一行
+        int now = myself ? 1 : 2;
+        updateNnue(&eval, nnue_cell_feature[pos], nnue_cell_feature[pos] + now);
+        for (Bits rest = flips; bitAny(rest);)
+        {
+            int base = nnue_cell_feature[bitPop(rest)];
+            updateNnue(&eval, base + 3 - now, base + now);
+        }
+    }
+    else
+#endif
+    {
+        if (eval_ref_cnt[pos] > 0)
+        {
+            updatePatterns(&eval, pos, myself ? 1 : 2);
+        }
+        for (Bits rest = flips & bit_pattern_cells; bitAny(rest);)
+        {
+            updatePatterns(&eval, bitPop(rest), myself ? -1 : 1);
+        }
+
+        //已经是前沿子的棋子被翻转时改变符号；新落的棋子可能让自己和周围的棋子成为前沿子
+        int flipped = bitSum(flips & eval.front, bit_eval_score.data());
+        eval.frontier += myself ? -2 * flipped : 2 * flipped;
+        if (bit_eval_score[pos] != 0)
+        {
+            Bits occupied = (board->own | board->opp) & bit_valued;
+            Bits fresh = bit_neighbors[pos] & occupied & bit_inner;
+            if (bitTest(bit_inner, pos) && bitAny(bit_neighbors[pos] & occupied))
+            {
+                bitSet(fresh, pos);
+            }
+            fresh &= ~eval.front;
+            eval.frontier += bitSum(fresh & board->opp, bit_eval_score.data()) - bitSum(fresh & board->own, bit_eval_score.data());
+            eval.front |= fresh;
+        }
+    }
+
+    int score = bitWeight(flips, bit_score_plane);
+    int point_score = bit_point_score[pos];
+    int your_delta = myself ? score + point_score : -score;
+    int opponent_delta = myself ? -score : score + point_score;
+    board->your_score += your_delta;
+    board->opponent_score += opponent_delta;
+
+    uint64_t hash_delta = myself ? zobrist_own[pos] : zobrist_opp[pos];
+    for (Bits rest = flips; bitAny(rest);)
+    {
+        hash_delta ^= zobrist_flip[bitPop(rest)];
+    }
+    board->hash ^= hash_delta;
+
+    //与 undoStepBits 的出栈配对，每步棋占一个格子，栈满说明调用方没有配对撤销
+    assert(bit_undo_top < BB_MAX_CELLS);
+    BitUndo &rec = bit_undo[bit_undo_top++];
+    rec.flips = flips;
+    rec.pos = pos;
+    rec.myself = myself;
+    rec.your_delta = your_delta;
+    rec.opponent_delta = opponent_delta;
+    rec.hash_delta = hash_delta;
+    rec.eval = old_eval;
+    return score + point_score;
+}
+
+void undoStepBits(BitBoard *board)
+{
+    BitUndo &rec = bit_undo[--bit_undo_top];
+    Bits &me = rec.myself ? board->own : board->opp;
+    Bits &op = rec.myself ? board->opp : board->own;
+    Bits placed = rec.flips;
+    bitSet(placed, rec.pos);
+    me &= ~placed;
+    op |= rec.flips;
+    board->your_score -= rec.your_delta;
+    board->opponent_score -= rec.opponent_delta;
+    board->hash ^= rec.hash_delta;
+    board->eval = rec.eval;
+}
+
+//与 evaluate 中的 board[x][y] 相同：我方为正的估值分数，对方为负，空格为 0
+int getPatternIndex(const BitBoard &board, int p)
+{
+    int index = 0;
+    for (int k = 0; k < eval_pattern_len[p]; k++)
+    {
+        int pos = eval_pattern_cells[p][k];
+        if (bitTest(board.own, pos))
+            index += pow3[k];
+        else if (bitTest(board.opp, pos))
+            index += 2 * pow3[k];
+    }
+    return index;
+}
+
+int evaluateBits(const BitBoard &board)
+{
+#if USE_NNUE
+    if (nnue_active)
+    {
+        EvalTerms terms;
+        refreshNnue(board, &terms);
+        return forwardNnue(terms);
+    }
+#endif
+    int score = 0;
+    for (int i = 0; i < eval_active_cnt; i++)
+    {
+        int p = eval_active[i];
+        score += eval_table[eval_pattern_offset[p] + getPatternIndex(board, p)];
+    }
+
+    //与 isFrontier 相同：周围八格中有估值非零棋子的内部棋子
+    Bits valued = bit_eval_plane[0] | bit_eval_plane[1] | bit_eval_plane[2] | bit_eval_plane[3];
+    Bits occupied = (board.own | board.opp) & valued;
+    Bits near = {};
+    for (int d = 0; d < 8; d++)
+    {
+        near |= bitShift(occupied, d);
+    }
+    Bits frontier = occupied & near & bit_inner;
+    int frontier_weight = bitWeight(frontier & board.opp, bit_eval_plane) - bitWeight(frontier & board.own, bit_eval_plane);
+
+    return score + 4 * frontier_weight;
+}
+
+int getPatternValue(int p, int index)
+{
+    int len = eval_pattern_len[p];
+    int value[EVAL_MAX_LEN];
+    for (int k = 0; k < len; k++, index /= 3)
+    {
+        int score = bit_eval_score[eval_pattern_cells[p][k]];
+        value[k] = index % 3 == 1 ? score : (index % 3 == 2 ? -score : 0);
+    }
+
+    //与 getStable 相同，12x12 的地图按 strategy 交换两项的系数
+    int corner_coef = bit_rows == 12 && strategy ? 12 : 14;
+    int steady_coef = bit_rows == 12 && strategy ? 14 : 12;
+    int current_score = value[0];
+    if (eval_pattern_type[p] == PATTERN_CORNER)
+    {
+        if (current_score != 0)
+        {
+            return corner_coef * current_score * 15;
+        }
+        int corner_weight = (value[1] + value[3]) * -3 + value[4] * -6 + (value[2] + value[6]) * 4 + (value[5] + value[7]) * 2;
+        return corner_coef * corner_weight;
+    }
+    if (eval_pattern_type[p] == PATTERN_EDGE)
+    {
+        int run = 0;
+        while (current_score != 0 && run < len && value[run] == current_score)
+        {
+            run++;
+        }
+        return steady_coef * current_score * run;
+    }
+    return 0;
+}
+
+bool loadEvalFile(const char *path)
+{
+    if (eval_file != NULL)
+    {
+        return true;
+    }
+    if (path[0] == '\0')
+    {
+        return false;
+    }
+    //与 loadBook 相同，文件描述符一直保持打开
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(EvalHeader))
+    {
+        return false;
+    }
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        return false;
+    }
+    const EvalHeader *header = (const EvalHeader *)addr;
+    size_t size = sizeof(EvalHeader);
+    bool ok = memcmp(header->magic, "CKEVAL", 7) == 0 && header->version == EVAL_VERSION;
+    for (uint32_t i = 0; ok && i < header->count; i++)
+    {
+        const EvalSection *section = (const EvalSection *)((const char *)addr + size);
+        ok = size + sizeof(EvalSection) <= (size_t)st.st_size && section->len <= EVAL_MAX_LEN;
+        if (ok)
+        {
+            size += sizeof(EvalSection) + pow3[section->len] * sizeof(int32_t);
+        }
+    }
+    if (!ok || size != (size_t)st.st_size)
+    {
+        munmap(addr, st.st_size);
+        return false;
+    }
+    eval_file = header;
+    eval_file_size = size;
+    return true;
+}
+
+const int32_t *findEvalSection(int type, int len)
+{
+    if (eval_file == NULL)
+    {
+        return NULL;
+    }
+    const char *cur = (const char *)(eval_file + 1);
+    for (uint32_t i = 0; i < eval_file->count; i++)
+    {
+        const EvalSection *section = (const EvalSection *)cur;
+        if ((int)section->type == type && (int)section->len == len)
+        {
+            return (const int32_t *)(section + 1);
+        }
+        cur += sizeof(EvalSection) + pow3[section->len] * sizeof(int32_t);
+    }
+    return NULL;
+}
+
+void initPatterns()
+{
+    pow3[0] = 1;
+    for (int k = 1; k <= EVAL_MAX_LEN; k++)
+    {
+        pow3[k] = pow3[k - 1] * 3;
+    }
+    loadEvalFile(EVAL_FILE);
+
+    //角的顺序与 getStable 中的 corner_map 相同，dy 和 dx 是从角指向棋盘内部的方向
+    int rows = bit_rows;
+    int cols = bit_cols;
+    int corner_map[4][4] = {{0, 0, 1, 1}, {0, cols - 1, 1, -1}, {rows - 1, 0, -1, 1}, {rows - 1, cols - 1, -1, -1}};
+    eval_pattern_cnt = 0;
+    for (int c = 0; c < 4; c++)
+    {
+        int x = corner_map[c][0], y = corner_map[c][1], dy = corner_map[c][2], dx = corner_map[c][3];
+        int p = eval_pattern_cnt++;
+        eval_pattern_type[p] = PATTERN_CORNER;
+        eval_pattern_len[p] = 9;
+        for (int k = 0; k < 9; k++)
+        {
+            eval_pattern_cells[p][k] = (x + k / 3 * dy) * cols + y + k % 3 * dx;
+        }
+    }
+    for (int c = 0; c < 4; c++)
+    {
+        int x = corner_map[c][0], y = corner_map[c][1], dy = corner_map[c][2], dx = corner_map[c][3];
+        int p = eval_pattern_cnt++;
+        eval_pattern_type[p] = PATTERN_EDGE;
+        eval_pattern_len[p] = min(cols, EVAL_EDGE_LEN);
+        for (int k = 0; k < eval_pattern_len[p]; k++)
+        {
+            eval_pattern_cells[p][k] = x * cols + y + k * dx;
+        }
+        p = eval_pattern_cnt++;
+        eval_pattern_type[p] = PATTERN_EDGE;
+        eval_pattern_len[p] = min(rows, EVAL_EDGE_LEN);
+        for (int k = 0; k < eval_pattern_len[p]; k++)
+        {
+            eval_pattern_cells[p][k] = (x + k * dy) * cols + y;
+        }
+    }
+    for (int c = 0; c < 4; c++)
+    {
+        int x = corner_map[c][0], y = corner_map[c][1], dy = corner_map[c][2], dx = corner_map[c][3];
+        int p = eval_pattern_cnt++;
+        eval_pattern_type[p] = PATTERN_DIAG;
+        eval_pattern_len[p] = min(min(rows, cols), EVAL_DIAG_LEN);
+        for (int k = 0; k < eval_pattern_len[p]; k++)
+        {
+            eval_pattern_cells[p][k] = (x + k * dy) * cols + y + k * dx;
+        }
+    }
+
+    //种类、长度和每个格子的分数都相同的模式值表也相同，共用一张表可以少占缓存
+    int total = 0;
+    vector<bool> shared(eval_pattern_cnt, false);
+    for (int p = 0; p < eval_pattern_cnt; p++)
+    {
+        eval_pattern_offset[p] = total;
+        for (int q = 0; q < p && !shared[p]; q++)
+        {
+            bool same = eval_pattern_type[q] == eval_pattern_type[p] && eval_pattern_len[q] == eval_pattern_len[p];
+            for (int k = 0; same && k < eval_pattern_len[p]; k++)
+            {
+                same = bit_eval_score[eval_pattern_cells[q][k]] == bit_eval_score[eval_pattern_cells[p][k]];
+            }
+            if (same)
+            {
+                eval_pattern_offset[p] = eval_pattern_offset[q];
+                shared[p] = true;
+            }
+        }
+        if (!shared[p])
+        {
+            total += pow3[eval_pattern_len[p]];
+        }
+    }
+
+    //拟合值按模式格子的平均分数放大，分数高的区域同样的形状更重要
+    eval_table.assign(total, 0);
+    for (int p = 0; p < eval_pattern_cnt; p++)
+    {
+        if (shared[p])
+        {
+            continue;
+        }
+        const int32_t *fitted = findEvalSection(eval_pattern_type[p], eval_pattern_len[p]);
+        double weight = 0;
+        for (int k = 0; k < eval_pattern_len[p]; k++)
+        {
+            weight += bit_eval_score[eval_pattern_cells[p][k]];
+        }
+        weight /= eval_pattern_len[p] * (double)EVAL_FILE_SCALE;
+        for (int index = 0; index < pow3[eval_pattern_len[p]]; index++)
+        {
+            double value = getPatternValue(p, index);
+            if (fitted != NULL)
+            {
+                value += fitted[index] * weight;
+            }
+            eval_table[eval_pattern_offset[p] + index] = (int16_t)max(-32767.0, min(32767.0, round(value)));
+        }
+    }
+
+    //没有手写评估项也没有拟合值的模式（例如没有模式表文件时的对角线）不必维护下标
+    eval_active_cnt = 0;
+    memset(eval_ref_cnt, 0, sizeof(eval_ref_cnt));
+    bit_pattern_cells = Bits();
+    for (int p = 0; p < eval_pattern_cnt; p++)
+    {
+        const int16_t *table = &eval_table[eval_pattern_offset[p]];
+        if (count(table, table + pow3[eval_pattern_len[p]], 0) == pow3[eval_pattern_len[p]])
+        {
+            continue;
+        }
+        eval_active[eval_active_cnt++] = p;
+        for (int k = 0; k < eval_pattern_len[p]; k++)
+        {
+            int pos = eval_pattern_cells[p][k];
+            PatternRef ref = {(uint8_t)p, (uint16_t)pow3[k]};
+            eval_refs[pos][eval_ref_cnt[pos]++] = ref;
+            bitSet(bit_pattern_cells, pos);
+        }
+    }
+}
+
+void initEvalTerms(BitBoard *board)
+{
+#if USE_NNUE
+    if (nnue_active)
+    {
+        refreshNnue(*board, &board->eval);
+        return;
+    }
+#endif
+    board->eval.pattern_score = 0;
+    for (int i = 0; i < eval_active_cnt; i++)
+    {
+        int p = eval_active[i];
+        board->eval.pattern[p] = (uint16_t)getPatternIndex(*board, p);
+        board->eval.pattern_score += eval_table[eval_pattern_offset[p] + board->eval.pattern[p]];
+    }
+    Bits occupied = (board->own | board->opp) & bit_valued;
+    Bits near = {};
+    for (int d = 0; d < 8; d++)
+    {
+        near |= bitShift(occupied, d);
+    }
+    board->eval.front = occupied & near & bit_inner;
+    board->eval.frontier = bitWeight(board->eval.front & board->opp, bit_eval_plane) - bitWeight(board->eval.front & board->own, bit_eval_plane);
+}
+
+int evaluateIncr(const BitBoard &board)
+{
+    PROFILE_SCOPE(PROF_EVAL_BITS, bit_undo_top);
+#if USE_NNUE
+    if (nnue_active)
+    {
+        return forwardNnue(board.eval);
+    }
+#endif
+    return board.eval.pattern_score + 4 * board.eval.frontier;
+}
+
+#if USE_NNUE
+bool loadNnueFile(const char *path)
+{
+    if (nnue_file != NULL)
+    {
+        return true;
+    }
+    if (path[0] == '\0')
+    {
+        return false;
+    }
+    //与 loadEvalFile 相同，文件描述符一直保持打开
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    size_t size = sizeof(NnueHeader) + (NNUE_FEATURES * NNUE_HIDDEN + NNUE_HIDDEN + NNUE_FEATURES) * sizeof(int16_t) +
+                  NNUE_HIDDEN2 * NNUE_HIDDEN * sizeof(int16_t) + NNUE_HIDDEN2 * sizeof(int32_t) +
+                  NNUE_HIDDEN2 * sizeof(int16_t) + sizeof(int32_t);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size != (off_t)size)
+    {
+        return false;
+    }
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        return false;
+    }
+    const NnueHeader *header = (const NnueHeader *)addr;
+    if (memcmp(header->magic, "CKNNUE", 7) != 0 || header->version != NNUE_VERSION ||
+        header->features != NNUE_FEATURES || header->hidden != NNUE_HIDDEN || header->hidden2 != NNUE_HIDDEN2)
+    {
+        munmap(addr, st.st_size);
+        return false;
+    }
+    const char *cur = (const char *)(header + 1);
+    nnue_w1 = (const int16_t *)cur;
+    nnue_b1 = nnue_w1 + NNUE_FEATURES * NNUE_HIDDEN;
+    nnue_wp = nnue_b1 + NNUE_HIDDEN;
+    nnue_w2 = nnue_wp + NNUE_FEATURES;
+    nnue_b2 = (const int32_t *)(nnue_w2 + NNUE_HIDDEN2 * NNUE_HIDDEN);
+    nnue_w3 = (const int16_t *)(nnue_b2 + NNUE_HIDDEN2);
+    nnue_b3 = (const int32_t *)(nnue_w3 + NNUE_HIDDEN2);
+    nnue_file = header;
+    return true;
+}
+
+void initNnue()
+{
+    //位置类别：到上下边的距离和到左右边的距离不分先后，棋盘按两条中线和对角线对称的格子类别相同
+    for (int i = 0; i < bit_rows; i++)
+    {
+        for (int j = 0; j < bit_cols; j++)
+        {
+            int a = min(min(i, bit_rows - 1 - i), NNUE_RINGS - 1);
+            int b = min(min(j, bit_cols - 1 - j), NNUE_RINGS - 1);
+            int cls = max(a, b) * (max(a, b) + 1) / 2 + min(a, b);
+            int pos = i * bit_cols + j;
+            int value = min(max(bit_point_score[pos], 0), NNUE_VALUES - 1);
+            nnue_cell_feature[pos] = (value * NNUE_CLASSES + cls) * 3;
+        }
+    }
+    nnue_active = loadNnueFile(NNUE_FILE);
+    nnue_kernel = NNUE_SCALAR;
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2"))
+        nnue_kernel = NNUE_AVX2;
+    else if (__builtin_cpu_supports("sse2"))
+        nnue_kernel = NNUE_SSE2;
+#endif
+}
+
+int getNnueFeatures(const BitBoard &board, bool swap, int *features)
+{
+    int cells = bit_rows * bit_cols;
+    for (int pos = 0; pos < cells; pos++)
+    {
+        int state = bitTest(board.own, pos) ? 1 : (bitTest(board.opp, pos) ? 2 : 0);
+        if (swap && state != 0)
+        {
+            state = 3 - state;
+        }
+        features[pos] = nnue_cell_feature[pos] + state;
+    }
+    return cells;
+}
+
+void refreshNnue(const BitBoard &board, EvalTerms *eval)
+{
+    int features[BB_MAX_CELLS];
+    int cnt = getNnueFeatures(board, false, features);
+    memcpy(eval->accum, nnue_b1, NNUE_HIDDEN * sizeof(int16_t));
+    eval->psqt = 0;
+    for (int i = 0; i < cnt; i++)
+    {
+        const int16_t *row = &nnue_w1[features[i] * NNUE_HIDDEN];
+        for (int k = 0; k < NNUE_HIDDEN; k++)
+        {
+            eval->accum[k] = (int16_t)(eval->accum[k] + row[k]);
+        }
+        eval->psqt += nnue_wp[features[i]];
+    }
+}
+
+//第二层的一个输出：加上偏置、除以 2^NNUE_QB_SHIFT 换回以 NNUE_QA 为 1 并截断
+inline int clipNnue(int sum, int bias)
+{
+    return min(max((sum + bias) >> NNUE_QB_SHIFT, 0), NNUE_QA);
+}
+
+int forwardNnueScalar(const int16_t *accum)
+{
+    int h1[NNUE_HIDDEN];
+    for (int k = 0; k < NNUE_HIDDEN; k++)
+    {
+        h1[k] = min(max((int)accum[k], 0), NNUE_QA);
+    }
+    int out = *nnue_b3;
+    for (int j = 0; j < NNUE_HIDDEN2; j++)
+    {
+        const int16_t *row = &nnue_w2[j * NNUE_HIDDEN];
+        int sum = 0;
+        for (int k = 0; k < NNUE_HIDDEN; k++)
+        {
+            sum += h1[k] * row[k];
+        }
+        out += clipNnue(sum, nnue_b2[j]) * nnue_w3[j];
+    }
+    return out;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+//截断后的激活值在 [0, NNUE_QA]，与 int16 权重用 madd 两两相乘相加不会溢出
+__attribute__((target("sse2"))) int forwardNnueSse2(const int16_t *accum)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i top = _mm_set1_epi16(NNUE_QA);
+    __m128i h1[NNUE_HIDDEN / 8];
+    for (int i = 0; i < NNUE_HIDDEN / 8; i++)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(accum + 8 * i));
+        h1[i] = _mm_min_epi16(_mm_max_epi16(a, zero), top);
+    }
+    int out = *nnue_b3;
+    for (int j = 0; j < NNUE_HIDDEN2; j++)
+    {
+        const int16_t *row = &nnue_w2[j * NNUE_HIDDEN];
+        __m128i sum = zero;
+        for (int i = 0; i < NNUE_HIDDEN / 8; i++)
+        {
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(h1[i], _mm_loadu_si128((const __m128i *)(row + 8 * i))));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+        out += clipNnue(_mm_cvtsi128_si32(sum), nnue_b2[j]) * nnue_w3[j];
+    }
+    return out;
+}
+
+__attribute__((target("avx2"))) int forwardNnueAvx2(const int16_t *accum)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i top = _mm256_set1_epi16(NNUE_QA);
+    __m256i h1[NNUE_HIDDEN / 16];
+    for (int i = 0; i < NNUE_HIDDEN / 16; i++)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(accum + 16 * i));
+        h1[i] = _mm256_min_epi16(_mm256_max_epi16(a, zero), top);
+    }
+    int out = *nnue_b3;
+    for (int j = 0; j < NNUE_HIDDEN2; j++)
+    {
+        const int16_t *row = &nnue_w2[j * NNUE_HIDDEN];
+        __m256i sum = zero;
+        for (int i = 0; i < NNUE_HIDDEN / 16; i++)
+        {
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(h1[i], _mm256_loadu_si256((const __m256i *)(row + 16 * i))));
+        }
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4e));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xb1));
+        out += clipNnue(_mm_cvtsi128_si32(half), nnue_b2[j]) * nnue_w3[j];
+    }
+    return out;
+}
+#endif
+
+int forwardNnue(const EvalTerms &eval)
+{
+    int out;
+    switch (nnue_kernel)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+    case NNUE_AVX2:
+        out = forwardNnueAvx2(eval.accum);
+        break;
+    case NNUE_SSE2:
+        out = forwardNnueSse2(eval.accum);
+        break;
+#endif
+    default:
+        out = forwardNnueScalar(eval.accum);
+        break;
+    }
+    return (int)lround((out + eval.psqt) * nnue_file->out_scale);
+}
+#endif
+
+void initTT(int size_mb)
+{
+    size_t entries = 1;
+    while (entries * 2 * sizeof(TTEntry) <= (size_t)size_mb << 20)
+    {
+        entries *= 2;
+    }
+    delete[] tt_table;
+    tt_table = new TTEntry[entries];
+    for (size_t i = 0; i < entries; i++)
+    {
+        tt_table[i].key.store(0, memory_order_relaxed);
+        tt_table[i].data.store(0, memory_order_relaxed);
+    }
+    tt_mask = entries - 1;
+    tt_age = 0;
+    tt_probes = tt_hits = tt_cutoffs = tt_collisions = 0;
+}
+
+bool probeTT(uint64_t key, TTData *out)
+{
+    TTEntry &entry = tt_table[key & tt_mask];
+    uint64_t check = entry.key.load(memory_order_relaxed);
+    uint64_t data = entry.data.load(memory_order_relaxed);
+    tt_probes++;
+    if ((check ^ data) != key)
+    {
+        if (data != 0)
+        {
+            tt_collisions++;
+        }
+        return false;
+    }
+    tt_hits++;
+    out->score = (int32_t)(uint32_t)data;
+    out->move = (int16_t)(data >> 32);
+    out->depth = (int8_t)(data >> 48);
+    out->bound = (data >> 56) & 3;
+    out->age = (data >> 58) & 63;
+    return true;
+}
+
+void storeTT(uint64_t key, int depth, TTBound bound, int score, int move)
+{
+    TTEntry &entry = tt_table[key & tt_mask];
+    uint64_t old = entry.data.load(memory_order_relaxed);
+    bool same = (entry.key.load(memory_order_relaxed) ^ old) == key;
+    if (old == 0 || same || ((old >> 58) & 63) != (tt_age & 63u) || (int8_t)(old >> 48) <= depth)
+    {
+        uint64_t data = (uint64_t)(uint32_t)score | (uint64_t)(uint16_t)move << 32 | (uint64_t)(uint8_t)depth << 48 | (uint64_t)(bound | (tt_age & 63) << 2) << 56;
+        entry.key.store(key ^ data, memory_order_relaxed);
+        entry.data.store(data, memory_order_relaxed);
+    }
+}
+
+int orderMoves(Bits moves, int tt_move, int ply, bool nowPlayer, int *list, int *score)
+{
+    int cnt = 0;
+    while (bitAny(moves))
+    {
+        int pos = bitPop(moves);
+        list[cnt] = pos;
+        if (pos == tt_move)
+            score[cnt] = ORDER_HASH;
+        else if (pos == killer_moves[ply][0])
+            score[cnt] = ORDER_KILLER;
+        else if (pos == killer_moves[ply][1])
+            score[cnt] = ORDER_KILLER - 1;
+        else
+            score[cnt] = history_table[nowPlayer][pos] + bit_order_score[pos];
+        cnt++;
+    }
+    return cnt;
+}
+
+int pickMove(int *list, int *score, int cnt, int i)
+{
+    int best = i;
+    for (int j = i + 1; j < cnt; j++)
+    {
+        if (score[j] > score[best])
+        {
+            best = j;
+        }
+    }
+    swap(list[i], list[best]);
+    swap(score[i], score[best]);
+    return list[i];
+}
+
+void updateOrder(int pos, int ply, int depth, bool nowPlayer)
+{
+    if (killer_moves[ply][0] != pos)
+    {
+        killer_moves[ply][1] = killer_moves[ply][0];
+        killer_moves[ply][0] = pos;
+    }
+    history_table[nowPlayer][pos] += depth * depth;
+}
+
+int pvsBits(BitBoard &board, int depth, int alpha, int beta, bool nowPlayer)
+{
+    if (checkTime())
+    {
+        return 0;
+    }
+    Bits moves = nowPlayer ? getValidMask(board.own, board.opp) : getValidMask(board.opp, board.own);
+    if (depth == 0 || !bitAny(moves))
+    {
+        return nowPlayer ? evaluateIncr(board) : -evaluateIncr(board);
+    }
+
+    //表项的得分和界都是从轮到下棋的一方看的
+    uint64_t key = board.hash ^ (nowPlayer ? 0 : zobrist_side);
+    TTData entry;
+    bool hit = probeTT(key, &entry);
+    if (hit && entry.move >= 0 && !bitTest(moves, entry.move))
+    {
+        tt_collisions++; //64 位哈希也撞上了，表项不可用
+        hit = false;
+    }
+    if (hit && entry.depth >= depth)
+    {
+        if (entry.bound == TT_EXACT || (entry.bound == TT_LOWER && entry.score >= beta) || (entry.bound == TT_UPPER && entry.score <= alpha))
+        {
+            tt_cutoffs++;
+            return entry.score;
+        }
+    }
+
+    //零窗口节点上浅层搜索以足够的把握超出窗口时，认为完整深度的搜索也会超出（ProbCut）
+    const ProbCutFit &fit = probcut_fit[min(depth, PROBCUT_MAX_DEPTH)];
+    if (probcut_enabled && depth >= PROBCUT_MIN_DEPTH && fit.reduction > 0 && beta == alpha + 1)
+    {
+        int shallow = depth - fit.reduction;
+        double margin = PROBCUT_T * fit.sigma;
+        int high = (int)ceil((beta + margin - fit.b) / fit.a);
+        if (high < SEARCH_INF && pvsBits(board, shallow, high - 1, high, nowPlayer) >= high && !search_stop)
+        {
+            probcut_cuts++;
+            return beta;
+        }
+        int low = (int)floor((alpha - margin - fit.b) / fit.a);
+        if (low > -SEARCH_INF && pvsBits(board, shallow, low, low + 1, nowPlayer) <= low && !search_stop)
+        {
+            probcut_cuts++;
+            return alpha;
+        }
+        if (search_stop)
+        {
+            return 0;
+        }
+    }
+
+    int ply = min(bit_undo_top, MAX_PLY - 1);
+    int list[BB_MAX_CELLS];
+    int order[BB_MAX_CELLS];
+    int cnt = orderMoves(moves, hit ? entry.move : -1, ply, nowPlayer, list, order);
+
+    int old_alpha = alpha;
+    int best_move = -1;
+    int best_score = -SEARCH_INF;
+    for (int i = 0; i < cnt; i++)
+    {
+        int pos = pickMove(list, order, cnt, i);
+        doStepBits(&board, pos, nowPlayer);
+        int score;
+        if (i == 0)
+        {
+            score = -pvsBits(board, depth - 1, -beta, -alpha, !nowPlayer);
+        }
+        else
+        {
+            //排序靠后的落子很少是最优的，先减少深度用零窗口搜索，超过 alpha 时再按完整深度重搜
+            int reduction = 0;
+            if (lmr_enabled && depth >= LMR_DEPTH && i >= LMR_MOVES)
+            {
+                reduction = i >= LMR_LATE_MOVES && depth >= LMR_DEPTH + 2 ? 2 : 1;
+                lmr_reductions++;
+            }
+            score = -pvsBits(board, depth - 1 - reduction, -alpha - 1, -alpha, !nowPlayer);
+            if (reduction > 0 && score > alpha)
+            {
+                lmr_researches++;
+                score = -pvsBits(board, depth - 1, -alpha - 1, -alpha, !nowPlayer);
+            }
+            if (score > alpha && score < beta)
+            {
+                score = -pvsBits(board, depth - 1, -beta, -alpha, !nowPlayer);
+            }
+        }
+        undoStepBits(&board);
+        if (search_stop)
+        {
+            return 0;
+        }
+
+        if (score > best_score)
+        {
+            best_score = score;
+            best_move = pos;
+        }
+        alpha = max(alpha, score);
+        if (alpha >= beta)
+        {
+            search_cutoffs++;
+            search_first_cutoffs += i == 0;
+            updateOrder(pos, ply, depth, nowPlayer);
+            storeTT(key, depth, TT_LOWER, best_score, pos);
+            return best_score;
+        }
+    }
+
+    storeTT(key, depth, best_score > old_alpha ? TT_EXACT : TT_UPPER, best_score, best_move);
+    return best_score;
+}
+
+int getTimeBudget(int empty_cnt)
+{
+    int budget = time_limit_ms;
+    if (game_time_ms > 0)
+    {
+        int moves_left = max(1, (empty_cnt + 1) / 2);
+        budget = min(budget, (int)max(1LL, (game_time_ms - game_time_used) / moves_left));
+    }
+    return budget;
+}
+
+bool checkTime()
+{
+    if ((++search_nodes & time_check_mask) == 0 && search_clock::now() >= search_deadline)
+    {
+        search_stop = true;
+    }
+    return search_stop;
+}
+
+int searchRoot(BitBoard &board, int *list, int cnt, int depth, int alpha, int beta, int *best_index)
+{
+    int max_score = -SEARCH_INF;
+    *best_index = 0;
+    for (int i = 0; i < cnt; i++)
+    {
+        doStepBits(&board, list[i], true);
+        int score;
+        if (i == 0)
+        {
+            score = -pvsBits(board, depth - 1, -beta, -alpha, false);
+        }
+        else
+        {
+            score = -pvsBits(board, depth - 1, -alpha - 1, -alpha, false);
+            if (score > alpha && score < beta)
+            {
+                score = -pvsBits(board, depth - 1, -beta, -alpha, false);
+            }
+        }
+        undoStepBits(&board);
+        if (search_stop)
+        {
+            break;
+        }
+
+        if (score > max_score)
+        {
+            max_score = score;
+            *best_index = i;
+        }
+        alpha = max(alpha, score);
+        if (alpha >= beta)
+        {
+            break;
+        }
+    }
+    return max_score;
+}
+
+int searchAspiration(BitBoard &board, int *list, int cnt, int depth, int guess, int *best_index)
+{
+    if (guess == INT_MIN || depth <= ASPIRATION_DEPTH)
+    {
+        return searchRoot(board, list, cnt, depth, -SEARCH_INF, SEARCH_INF, best_index);
+    }
+    int delta = ASPIRATION_WINDOW;
+    int alpha = max(-SEARCH_INF, guess - delta);
+    int beta = min(SEARCH_INF, guess + delta);
+    while (true)
+    {
+        int score = searchRoot(board, list, cnt, depth, alpha, beta, best_index);
+        if (search_stop || (score > alpha && score < beta))
+        {
+            return score;
+        }
+        //高出窗口时 best_index 的落子已经比其他落子好，放到最前面重搜；低出窗口时所有落子都只有上界
+        delta *= 2;
+        if (score <= alpha)
+        {
+            if (alpha == -SEARCH_INF)
+            {
+                return score;
+            }
+            alpha = max(-SEARCH_INF, score - delta);
+        }
+        else
+        {
+            if (beta == SEARCH_INF)
+            {
+                return score;
+            }
+            rotate(list, list + *best_index, list + *best_index + 1);
+            *best_index = 0;
+            beta = min(SEARCH_INF, score + delta);
+        }
+    }
+}
+
+void doStepEnd(BitBoard *board, int pos, bool myself)
+{
+    PROFILE_SCOPE(PROF_DO_STEP_END, bit_undo_top);
+    Bits &me = myself ? board->own : board->opp;
+    Bits &op = myself ? board->opp : board->own;
+    Bits flips = getFlipMask(me, op, pos);
+    me |= flips;
+    bitSet(me, pos);
+    op &= ~flips;
+
+    int score = bit_point_score[pos];
+    uint64_t hash = myself ? zobrist_own[pos] : zobrist_opp[pos];
+    while (bitAny(flips))
+    {
+        int p = bitPop(flips);
+        score += bit_point_score[p];
+        hash ^= zobrist_flip[p];
+    }
+    board->hash ^= hash;
+    if (myself)
+    {
+        board->your_score += score;
+        board->opponent_score -= score - bit_point_score[pos];
+    }
+    else
+    {
+        board->opponent_score += score;
+        board->your_score -= score - bit_point_score[pos];
+    }
+}
+
+int orderEndMoves(const BitBoard &board, Bits moves, int hash_move, bool nowPlayer, int empties, int *list, int *score)
+{
+    const Bits &me = nowPlayer ? board.own : board.opp;
+    const Bits &op = nowPlayer ? board.opp : board.own;
+    Bits empty = bit_full & ~(board.own | board.opp);
+    Bits odd = {};
+    for (int q = 0; q < 4; q++)
+    {
+        if (bitCount(empty & bit_quadrant[q]) & 1)
+        {
+            odd |= bit_quadrant[q];
+        }
+    }
+
+    int cnt = 0;
+    while (bitAny(moves))
+    {
+        int pos = bitPop(moves);
+        list[cnt] = pos;
+        if (pos == hash_move)
+        {
+            score[cnt] = ORDER_HASH;
+        }
+        else if (empties >= EG_FASTEST_EMPTIES)
+        {
+            Bits flips = getFlipMask(me, op, pos);
+            Bits next_me = me | flips | bitSingle(pos);
+            Bits next_op = op & ~flips;
+            score[cnt] = -1024 * bitCount(getValidMask(next_op, next_me)) + 512 * bitTest(odd, pos) + bit_order_score[pos];
+        }
+        else
+        {
+            score[cnt] = 4096 * bitTest(odd, pos) + bit_order_score[pos];
+        }
+        cnt++;
+    }
+    return cnt;
+}
+
+int solveBits(BitBoard &board, int alpha, int beta, bool nowPlayer, int empties)
+{
+    if (checkTime())
+    {
+        return 0;
+    }
+    Bits moves = nowPlayer ? getValidMask(board.own, board.opp) : getValidMask(board.opp, board.own);
+    if (!bitAny(moves))
+    {
+        Bits other = nowPlayer ? getValidMask(board.opp, board.own) : getValidMask(board.own, board.opp);
+        if (!bitAny(other))
+        {
+            return board.your_score - board.opponent_score;
+        }
+        return solveBits(board, alpha, beta, !nowPlayer, empties);
+    }
+
+    //哈希表中存的是相对当前分差的增量
+    int base = board.your_score - board.opponent_score;
+    uint64_t key = board.hash ^ (nowPlayer ? 0 : zobrist_side);
+    EndEntry *entry = NULL;
+    int hash_move = -1;
+    if (empties >= EG_HASH_EMPTIES)
+    {
+        entry = &end_table[key & (end_table.size() - 1)];
+        if (entry->key == key)
+        {
+            if (entry->lower + base >= beta)
+                return beta;
+            if (entry->upper + base <= alpha)
+                return alpha;
+            if (entry->lower == entry->upper)
+                return entry->lower + base;
+            hash_move = entry->move;
+        }
+    }
+
+    int list[BB_MAX_CELLS];
+    int order[BB_MAX_CELLS];
+    int cnt = orderEndMoves(board, moves, hash_move, nowPlayer, empties, list, order);
+
+    int old_alpha = alpha;
+    int old_beta = beta;
+    int best_move = -1;
+    BitBoard saved = board;
+    for (int i = 0; i < cnt; i++)
+    {
+        int pos = pickMove(list, order, cnt, i);
+        doStepEnd(&board, pos, nowPlayer);
+        int score = solveBits(board, alpha, beta, !nowPlayer, empties - 1);
+        board.own = saved.own;
+        board.opp = saved.opp;
+        board.your_score = saved.your_score;
+        board.opponent_score = saved.opponent_score;
+        board.hash = saved.hash;
+        if (search_stop)
+        {
+            return 0;
+        }
+
+        if (nowPlayer && score > alpha)
+        {
+            alpha = score;
+            best_move = pos;
+        }
+        else if (!nowPlayer && score < beta)
+        {
+            beta = score;
+            best_move = pos;
+        }
+        if (beta <= alpha)
+        {
+            break;
+        }
+    }
+
+    int result = nowPlayer ? min(alpha, old_beta) : max(beta, old_alpha);
+    if (entry != NULL)
+    {
+        if (entry->key != key)
+        {
+            entry->key = key;
+            entry->lower = -EG_INF;
+            entry->upper = EG_INF;
+            entry->move = -1;
+        }
+        if (result > old_alpha)
+            entry->lower = max(entry->lower, result - base);
+        if (result < old_beta)
+            entry->upper = min(entry->upper, result - base);
+        if (best_move >= 0)
+            entry->move = best_move;
+    }
+    return result;
+}
+
+int solveRoot(BitBoard &board, int *list, int cnt, int empties, int *best_index)
+{
+    int max_score = INT_MIN;
+    *best_index = 0;
+    for (int i = 0; i < cnt; i++)
+    {
+        doStepBits(&board, list[i], true);
+        //先用零窗口判断能否超过当前最优，超过时再求准确值
+        int score = solveBits(board, max_score, max_score == INT_MIN ? INT_MAX : max_score + 1, false, empties - 1);
+        if (score > max_score && max_score != INT_MIN && !search_stop)
+        {
+            score = solveBits(board, max_score, INT_MAX, false, empties - 1);
+        }
+        undoStepBits(&board);
+        if (search_stop)
+        {
+            break;
+        }
+
+        if (score > max_score)
+        {
+            max_score = score;
+            *best_index = i;
+        }
+    }
+    return max_score;
+}
+
+uint64_t getMapKey(Player *player)
+{
+    uint64_t key = 14695981039346656037ULL;
+    int header[2] = {player->row_cnt, player->col_cnt};
+    for (int k = 0; k < 2; k++)
+    {
+        key = (key ^ (uint64_t)header[k]) * 1099511628211ULL;
+    }
+    for (int i = 0; i < player->row_cnt; i++)
+    {
+        for (int j = 0; j < player->col_cnt; j++)
+        {
+            key = (key ^ (unsigned char)player->mat[i][j]) * 1099511628211ULL;
+        }
+    }
+    return key;
+}
+
+bool loadBook(const char *path)
+{
+    if (book_table != NULL)
+    {
+        return true;
+    }
+    //check_player 不允许 close 系统调用，文件描述符一直保持打开，映射在进程结束时释放
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(BookHeader))
+    {
+        return false;
+    }
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        return false;
+    }
+    const BookHeader *header = (const BookHeader *)addr;
+    if (memcmp(header->magic, "CKBOOK", 7) != 0 || header->version != BOOK_VERSION ||
+        (off_t)(sizeof(BookHeader) + (uint64_t)header->count * sizeof(BookEntry)) != st.st_size)
+    {
+        munmap(addr, st.st_size);
+        return false;
+    }
+    book_table = (const BookEntry *)(header + 1);
+    book_cnt = header->count;
+    return true;
+}
+
+int probeBook(uint64_t pos_key)
+{
+    uint32_t lo = 0, hi = book_cnt;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const BookEntry &entry = book_table[mid];
+        if (entry.map_key < book_map_key || (entry.map_key == book_map_key && entry.pos_key < pos_key))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < book_cnt && book_table[lo].map_key == book_map_key && book_table[lo].pos_key == pos_key)
+    {
+        return book_table[lo].move;
+    }
+    return -1;
+}
+
+void loadSearchState(int shift)
+{
+    memcpy(history_table, game_history, sizeof(history_table));
+    for (int ply = 0; ply < MAX_PLY; ply++)
+    {
+        for (int k = 0; k < 2; k++)
+        {
+            killer_moves[ply][k] = ply + shift < MAX_PLY ? game_killers[ply + shift][k] : -1;
+        }
+    }
+}
+
+int findReply(const BitBoard &board)
+{
+    if (!game_last_valid)
+    {
+        return -1;
+    }
+    BitBoard next = game_last;
+    Bits replies = getValidMask(next.opp, next.own);
+    while (bitAny(replies))
+    {
+        int pos = bitPop(replies);
+        doStepBits(&next, pos, false);
+        bool same = next.hash == board.hash && memcmp(&next.own, &board.own, sizeof(Bits)) == 0 &&
+                    memcmp(&next.opp, &board.opp, sizeof(Bits)) == 0;
+        undoStepBits(&next);
+        if (same)
+        {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+void saveSearchState(const BitBoard &board, int pos)
+{
+    memcpy(game_history, history_table, sizeof(game_history));
+    memcpy(game_killers, killer_moves, sizeof(game_killers));
+
+    BitBoard line = board;
+    bool nowPlayer = true;
+    game_pv_len = 0;
+    while (game_pv_len < MAX_PLY)
+    {
+        game_pv[game_pv_len++] = pos;
+        doStepBits(&line, pos, nowPlayer);
+        if (game_pv_len == 1)
+        {
+            game_last = line;
+        }
+        nowPlayer = !nowPlayer;
+        Bits moves = nowPlayer ? getValidMask(line.own, line.opp) : getValidMask(line.opp, line.own);
+        TTData entry;
+        if (!probeTT(line.hash ^ (nowPlayer ? 0 : zobrist_side), &entry) || entry.move < 0 || !bitTest(moves, entry.move))
+        {
+            break;
+        }
+        pos = entry.move;
+    }
+    for (int i = 0; i < game_pv_len; i++)
+    {
+        undoStepBits(&line);
+    }
+    game_last_valid = true;
+}
+
+void helperSearch(BitBoard board, vector<int> list, int max_depth, int id)
+{
+    int cnt = (int)list.size();
+    bit_undo_top = 0;
+    search_nodes = 0;
+    loadSearchState(0);
+
+    int guess = INT_MIN;
+    for (int depth = 1 + (id & 1); depth <= max_depth; depth++)
+    {
+        int best_index;
+        guess = searchAspiration(board, list.data(), cnt, depth, guess, &best_index);
+        if (search_stop)
+        {
+            break;
+        }
+        rotate(list.begin(), list.begin() + best_index, list.begin() + best_index + 1);
+    }
+    helper_nodes += search_nodes;
+}
+
+void ponderSearch(BitBoard board, int max_depth)
+{
+    int list[BB_MAX_CELLS];
+    int order[BB_MAX_CELLS];
+    bit_undo_top = 0;
+    search_nodes = 0;
+    loadSearchState(2);
+    int cnt = orderMoves(getValidMask(board.own, board.opp), -1, 0, true, list, order);
+    for (int i = 0; i < cnt; i++)
+    {
+        pickMove(list, order, cnt, i);
+    }
+
+    int guess = INT_MIN;
+    for (int depth = 1; depth <= max_depth; depth++)
+    {
+        int best_index;
+        guess = searchAspiration(board, list, cnt, depth, guess, &best_index);
+        if (search_stop)
+        {
+            break;
+        }
+        ponder_move = list[best_index];
+        ponder_score = guess;
+        ponder_depth = depth;
+        rotate(list, list + best_index, list + best_index + 1);
+    }
 }
 
-int doStep(Player *player, int stepX, int stepY, bool myself)
+void startPonder(const BitBoard &board, int pos)
 {
-    char myPiece = myself ? 'O' : 'o';           //判断这一步下的是哪种棋子
-    player->mat[stepX][stepY] = myPiece;         //在落子位置放上我方棋子
+    ponder_key = 0;
+    ponder_move = -1;
+    ponder_depth = 0;
 
-    int directions[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+    BitBoard next = board;
+    int steps = 1;
+    doStepBits(&next, pos, true);
+    Bits replies = getValidMask(next.opp, next.own);
+    if (bitAny(replies))
+    {
+        //主线中对方的最优应对在置换表里，查不到时取排序分最高的落子
+        TTData entry;
+        int reply;
+        if (probeTT(next.hash ^ zobrist_side, &entry) && entry.move >= 0 && bitTest(replies, entry.move))
+        {
+            reply = entry.move;
+        }
+        else
+        {
+            int list[BB_MAX_CELLS];
+            int order[BB_MAX_CELLS];
+            int cnt = orderMoves(replies, -1, 0, false, list, order);
+            reply = pickMove(list, order, cnt, 0);
+        }
+        doStepBits(&next, reply, false);
+        steps++;
+    }
+    BitBoard root = next;
+    while (steps-- > 0)
+    {
+        undoStepBits(&next);
+    }
 
-    int score = 0;
+    int empty_cnt = bitCount(bit_full & ~(root.own | root.opp));
+    if (!bitAny(getValidMask(root.own, root.opp)) || empty_cnt <= endgame_empties)
+    {
+        return;
+    }
+    ponder_key = root.hash;
+    search_deadline = search_clock::time_point::max();
+    search_stop = false;
+    tt_age++;
+    ponder_thread = thread(ponderSearch, root, min(min(empty_cnt, MAX_PLY), depth_limit));
+#if USE_PONDER && defined(__linux__) && defined(SCHED_IDLE)
+    //后台搜索只用空闲的 CPU，单核或机器繁忙时不拖慢评测程序和读下一个棋盘的线程
+    sched_param param = {0};
+    pthread_setschedparam(ponder_thread.native_handle(), SCHED_IDLE, &param);
+#endif
+}
 
-    //向落子的八个方向探索，并进行翻转
-    for (int i = 0; i < 8; i++)
+void stopPonder()
+{
+    if (ponder_thread.joinable())
     {
-        score += Flip(player, stepX, stepY, directions[i][0], directions[i][1], myself);
+        search_stop = true;
+        ponder_thread.join();
     }
+}
 
-    int point_score = getScoreOfPoint(stepX, stepY);//获取落子点的分数
+Point placeBits(Player *player)
+{
+    search_clock::time_point start = search_clock::now();
+    //后台搜索每 1024 个节点检查一次 search_stop，停下来只需要很短的时间
+    stopPonder();
+    bit_kernel = selectKernel(player->row_cnt, player->col_cnt);
+    BitBoard board = loadBits(player);
+    Bits moves = getValidMask(board.own, board.opp);
+    int empty_cnt = bitCount(bit_full & ~(board.own | board.opp));
+
+    //开局库命中时直接返回，第一次未命中后就已经出库，不再查询
+    if (book_active)
+    {
+        int pos = probeBook(board.hash);
+        if (pos >= 0 && bitTest(moves, pos))
+        {
+            game_last_valid = false;
+            search_report.source = "book";
+            return initPoint(pos / bit_cols, pos % bit_cols);
+        }
+        book_active = false;
+    }
+
+    //猜中对方落子时后台搜索的结果直接可用，置换表也已经填好，从下一层接着加深
+    bool ponder_hit = ponder_depth > 0 && ponder_key == board.hash && bitTest(moves, ponder_move);
+
+    int budget = getTimeBudget(empty_cnt);
+    if (ponder_enabled)
+    {
+        budget = max(1, budget - PONDER_MARGIN_MS);
+    }
+    search_deadline = start + chrono::milliseconds(budget);
+    search_stop = false;
+    search_nodes = 0;
+    helper_nodes = 0;
+    bit_undo_top = 0;
+    if (!ponder_hit)
+    {
+        tt_age++;
+    }
+    tt_probes = tt_hits = tt_cutoffs = tt_collisions = 0;
+    search_cutoffs = search_first_cutoffs = 0;
 
-    //我方落子引起的得分变化
-    if (myself) 
+    //当前局面是上一步搜索树中的后继时，杀手落子平移两层接着用，历史表减半后保留
+    int reply = findReply(board);
+    if (reply >= 0)
     {
-        player->your_score += score + point_score;
-        player->opponent_score -= score;
+        memmove(game_killers, game_killers + 2, sizeof(game_killers[0]) * (MAX_PLY - 2));
+        memset(game_killers + MAX_PLY - 2, -1, sizeof(game_killers[0]) * 2);
     }
-    //对方落子引起的得分变化
     else
     {
-        player->opponent_score += score + point_score;
-        player->your_score -= score;
+        memset(game_killers, -1, sizeof(game_killers));
     }
-    return score + point_score;
+    for (int side = 0; side < 2; side++)
+    {
+        for (int pos = 0; pos < BB_MAX_CELLS; pos++)
+        {
+            game_history[side][pos] /= 2;
+        }
+    }
+    loadSearchState(0);
+
+    //置换表中这个局面的最优落子最先搜索，没有时取上一步主要变例中的下一步
+    int root_move = -1;
+    TTData entry;
+    if (probeTT(board.hash, &entry) && entry.move >= 0 && bitTest(moves, entry.move))
+    {
+        root_move = entry.move;
+    }
+    else if (reply >= 0 && game_pv_len >= 3 && game_pv[1] == reply && bitTest(moves, game_pv[2]))
+    {
+        root_move = game_pv[2];
+    }
+
+    //没有完成任何一层时至少返回一个合法落子点
+    Point point = initPoint(-1, -1);
+
+    //上一层的最优落子最先搜索，其余按历史表和静态排序分
+    int list[BB_MAX_CELLS];
+    int order[BB_MAX_CELLS];
+    int cnt = orderMoves(moves, root_move, 0, true, list, order);
+    for (int i = 0; i < cnt; i++)
+    {
+        pickMove(list, order, cnt, i);
+    }
+    if (cnt > 0)
+    {
+        point = initPoint(list[0] / bit_cols, list[0] % bit_cols);
+    }
+
+    int depth_done = 0;
+    int guess = INT_MIN;
+    search_report.source = "search";
+    search_report.ponder_hit = ponder_hit;
+    if (ponder_hit)
+    {
+        int *hit = find(list, list + cnt, ponder_move);
+        rotate(list, hit, hit + 1);
+        point = initPoint(ponder_move / bit_cols, ponder_move % bit_cols);
+        depth_done = ponder_depth;
+        guess = ponder_score;
+    }
+    int first_depth = depth_done + 1;
+
+    //剩余空格不多时先精确求解终局分差，用一半时间解不出来再回到迭代加深
+    bool solved = false;
+    if (empty_cnt <= endgame_empties && cnt > 1)
+    {
+        search_deadline = start + chrono::milliseconds(budget) / 2;
+        int best_index;
+        int score = solveRoot(board, list, cnt, empty_cnt, &best_index);
+        if (!search_stop)
+        {
+            point = initPoint(list[best_index] / bit_cols, list[best_index] % bit_cols);
+            depth_done = empty_cnt;
+            solved = true;
+            search_report.source = "solve";
+            search_report.score = score;
+        }
+        search_deadline = start + chrono::milliseconds(budget);
+        search_stop = false;
+    }
+
+    int max_depth = min(min(empty_cnt, MAX_PLY), depth_limit);
+    int threads = search_threads > 0 ? search_threads : max(1u, thread::hardware_concurrency());
+    vector<thread> helpers;
+    for (int id = 1; id < threads && cnt > 1 && !solved; id++)
+    {
+        helpers.push_back(thread(helperSearch, board, vector<int>(list, list + cnt), max_depth, id));
+    }
+
+    for (int depth = first_depth; depth <= max_depth && cnt > 0 && !solved; depth++)
+    {
+        int best_index;
+        int score = searchAspiration(board, list, cnt, depth, guess, &best_index);
+        if (search_stop)
+        {
+            break;
+        }
+        point = initPoint(list[best_index] / bit_cols, list[best_index] % bit_cols);
+        depth_done = depth;
+        guess = score;
+        search_report.score = score;
+        rotate(list, list + best_index, list + best_index + 1);
+
+        //下一层的耗时通常是这一层的数倍，剩余时间不到一半时不再开始新的一层
+        if (search_clock::now() - start > chrono::milliseconds(budget) / 2)
+        {
+            break;
+        }
+    }
+    search_stop = true;
+    for (size_t i = 0; i < helpers.size(); i++)
+    {
+        helpers[i].join();
+    }
+
+    game_time_used += chrono::duration_cast<chrono::milliseconds>(search_clock::now() - start).count();
+    if (move_cnt < (int)depth_log.size())
+    {
+        depth_log[move_cnt] = depth_done;
+    }
+    search_report.depth = depth_done;
+    if (point.X >= 0)
+    {
+        saveSearchState(board, point.X * bit_cols + point.Y);
+    }
+    else
+    {
+        game_last_valid = false;
+    }
+    if (ponder_enabled && point.X >= 0)
+    {
+        startPonder(board, point.X * bit_cols + point.Y);
+    }
+    return point;
 }
 
-Player *copyPlayer(Player *player)
+bool expandMcts(MctsNode &node, const BitBoard &board)
 {
-    Player *new_player = new Player;
-    new_player->row_cnt = player->row_cnt;
-    new_player->col_cnt = player->col_cnt;
+    bool nowPlayer = !node.myself;
+    Bits moves = nowPlayer ? getValidMask(board.own, board.opp) : getValidMask(board.opp, board.own);
+    int cnt = bitCount(moves);
+    if (cnt == 0)
+    {
+        Bits replies = nowPlayer ? getValidMask(board.opp, board.own) : getValidMask(board.own, board.opp);
+        cnt = bitAny(replies) ? 1 : 0;
+    }
+    if (mcts_node_top.load() + cnt > (int)mcts_nodes.size())
+    {
+        node.state.store(MCTS_LEAF);
+        return false;
+    }
+    int first = mcts_node_top.fetch_add(cnt);
+    if (first + cnt > (int)mcts_nodes.size())
+    {
+        node.state.store(MCTS_LEAF);
+        return false;
+    }
+    for (int i = 0; i < cnt; i++)
+    {
+        MctsNode &child = mcts_nodes[first + i];
+        child.visits.store(0, memory_order_relaxed);
+        child.wins.store(0, memory_order_relaxed);
+        child.state.store(MCTS_LEAF, memory_order_relaxed);
+        child.move = bitAny(moves) ? bitPop(moves) : -1;
+        child.myself = nowPlayer;
+    }
+    node.first_child = first;
+    node.child_cnt = cnt;
+    node.state.store(MCTS_EXPANDED, memory_order_release);
+    return true;
+}
 
-    new_player->mat = new char *[new_player->row_cnt];
-    for (int i = 0; i < new_player->row_cnt; i++)
+int selectMcts(const MctsNode &node)
+{
+    double log_n = log((double)max(1, node.visits.load(memory_order_relaxed)));
+    int best = 0;
+    double best_value = -1;
+    for (int i = 0; i < node.child_cnt; i++)
     {
-        new_player->mat[i] = new char[new_player->col_cnt];
-        memcpy(new_player->mat[i], player->mat[i], new_player->col_cnt * sizeof(char));
+        const MctsNode &child = mcts_nodes[node.first_child + i];
+        int n = child.visits.load(memory_order_relaxed);
+        if (n == 0)
+        {
+            return i;
+        }
+        double value = (double)child.wins.load(memory_order_relaxed) / ((double)n * MCTS_ONE) + MCTS_UCT_C * sqrt(log_n / n);
+        if (value > best_value)
+        {
+            best_value = value;
+            best = i;
+        }
     }
+    return best;
+}
 
-    return new_player;
+int playoutMcts(BitBoard board, bool nowPlayer, uint64_t &rng)
+{
+    //连续两次无子可下时终局，跳过不需要落子
+    for (int passes = 0; passes < 2; nowPlayer = !nowPlayer)
+    {
+        Bits moves = nowPlayer ? getValidMask(board.own, board.opp) : getValidMask(board.opp, board.own);
+        int cnt = bitCount(moves);
+        if (cnt == 0)
+        {
+            passes++;
+            continue;
+        }
+        passes = 0;
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        for (int k = (int)(((rng >> 32) * cnt) >> 32); k > 0; k--)
+        {
+            bitPop(moves);
+        }
+        doStepEnd(&board, bitPop(moves), nowPlayer);
+    }
+
+    int diff = board.your_score - board.opponent_score;
+    int result = diff > 0 ? MCTS_ONE : (diff < 0 ? 0 : MCTS_ONE / 2);
+    double margin = 0.5 + 0.5 * diff / max(1, general_score);
+    margin = min(1.0, max(0.0, margin));
+    return (int)(result * (1 - MCTS_MARGIN_WEIGHT) + margin * MCTS_MARGIN_WEIGHT * MCTS_ONE);
 }
 
-void freePlayer(Player *player)
+void mctsSearch(BitBoard root, int id)
 {
-    for (int i = 0; i < player->row_cnt; i++)
+    uint64_t rng = 0x9E3779B97F4A7C15ULL * (id + 1) ^ (uint64_t)search_clock::now().time_since_epoch().count();
+    rng |= 1;
+    int path[2 * BB_MAX_CELLS + 1];
+    search_nodes = 0;
+
+    //每次随机对局要几十微秒，每次都检查时间
+    while (!search_stop)
     {
-        delete[] player->mat[i];
+        if (search_clock::now() >= search_deadline)
+        {
+            search_stop = true;
+            break;
+        }
+        BitBoard board = root;
+        int len = 0;
+        int idx = 0;
+        path[len++] = idx;
+        mcts_nodes[idx].visits++;
+        while (true)
+        {
+            MctsNode &node = mcts_nodes[idx];
+            if (node.state.load(memory_order_acquire) != MCTS_EXPANDED)
+            {
+                int expected = MCTS_LEAF;
+                if (node.visits.load(memory_order_relaxed) < MCTS_EXPAND_VISITS ||
+                    !node.state.compare_exchange_strong(expected, MCTS_EXPANDING) || !expandMcts(node, board))
+                {
+                    break;
+                }
+            }
+            if (node.child_cnt == 0)
+            {
+                break;
+            }
+            idx = node.first_child + selectMcts(node);
+            MctsNode &child = mcts_nodes[idx];
+            child.visits++;
+            if (child.move >= 0)
+            {
+                doStepEnd(&board, child.move, child.myself);
+            }
+            path[len++] = idx;
+        }
+
+        int reward = playoutMcts(board, !mcts_nodes[idx].myself, rng);
+        for (int i = 0; i < len; i++)
+        {
+            MctsNode &node = mcts_nodes[path[i]];
+            node.wins += node.myself ? reward : MCTS_ONE - reward;
+        }
+        search_nodes++;
+    }
+    if (id > 0)
+    {
+        helper_nodes += search_nodes;
+    }
+}
+
+Point placeMcts(Player *player)
+{
+    search_clock::time_point start = search_clock::now();
+    stopPonder();
+    game_last_valid = false;
+    bit_kernel = selectKernel(player->row_cnt, player->col_cnt);
+    BitBoard board = loadBits(player);
+    int empty_cnt = bitCount(bit_full & ~(board.own | board.opp));
+    int budget = getTimeBudget(empty_cnt);
+    search_deadline = start + chrono::milliseconds(budget);
+    search_stop = false;
+    search_nodes = 0;
+    helper_nodes = 0;
+    search_report.source = "mcts";
+
+    //根节点当作对方刚走过的节点，轮到我方下棋
+    mcts_node_top = 1;
+    MctsNode &root = mcts_nodes[0];
+    root.visits = 0;
+    root.wins = 0;
+    root.move = -1;
+    root.myself = false;
+    root.state = MCTS_EXPANDING;
+    expandMcts(root, board);
+
+    Point point = initPoint(-1, -1);
+    if (root.child_cnt > 0 && mcts_nodes[root.first_child].move >= 0)
+    {
+        point = initPoint(mcts_nodes[root.first_child].move / bit_cols, mcts_nodes[root.first_child].move % bit_cols);
+    }
+    if (root.child_cnt > 1 && point.X >= 0)
+    {
+        int threads = search_threads > 0 ? search_threads : max(1u, thread::hardware_concurrency());
+        vector<thread> helpers;
+        for (int id = 1; id < threads; id++)
+        {
+            helpers.push_back(thread(mctsSearch, board, id));
+        }
+        mctsSearch(board, 0);
+        for (size_t i = 0; i < helpers.size(); i++)
+        {
+            helpers[i].join();
+        }
+
+        //访问次数最多的落子最可靠，沿访问次数最多的子节点走下去得到主要变例
+        int depth = 0;
+        for (const MctsNode *node = &root; node->state.load() == MCTS_EXPANDED && node->child_cnt > 0; depth++)
+        {
+            const MctsNode *best = &mcts_nodes[node->first_child];
+            for (int i = 1; i < node->child_cnt; i++)
+            {
+                if (mcts_nodes[node->first_child + i].visits > best->visits)
+                {
+                    best = &mcts_nodes[node->first_child + i];
+                }
+            }
+            if (best->visits == 0)
+            {
+                break;
+            }
+            if (node == &root)
+            {
+                point = initPoint(best->move / bit_cols, best->move % bit_cols);
+                search_report.score = (int)(best->wins * 1000 / ((long long)best->visits * MCTS_ONE));
+            }
+            node = best;
+        }
+        search_report.depth = depth;
+    }
+
+    game_time_used += chrono::duration_cast<chrono::milliseconds>(search_clock::now() - start).count();
+    if (move_cnt < (int)depth_log.size())
+    {
+        depth_log[move_cnt] = search_report.depth;
+    }
+    return point;
+}
+
+int getMailValue(const MailBoard &board, int pos)
+{
+    if (board.cell[pos] == MB_OWN)
+        return mail_eval_score[pos];
+    if (board.cell[pos] == MB_OPP)
+        return -mail_eval_score[pos];
+    return 0;
+}
+
+void initMail(Player *player)
+{
+    int rows = player->row_cnt;
+    int cols = player->col_cnt;
+    mail_enabled = rows >= 3 && cols >= 3 && rows <= MB_MAX_SIDE && cols <= MB_MAX_SIDE;
+    if (!mail_enabled)
+    {
+        return;
+    }
+    mail_rows = rows;
+    mail_cols = cols;
+    mail_stride = cols + 2;
+
+    int directions[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+    for (int d = 0; d < 8; d++)
+    {
+        mail_dir[d] = directions[d][0] * mail_stride + directions[d][1];
+    }
+
+    memset(mail_point_score, 0, sizeof(mail_point_score));
+    memset(mail_eval_score, 0, sizeof(mail_eval_score));
+    memset(mail_ray_dirs, 0, sizeof(mail_ray_dirs));
+    vector<pair<int, int>> order;
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            int pos = (i + 1) * mail_stride + j + 1;
+            mail_point_score[pos] = getScoreOfPoint(i, j);
+            mail_eval_score[pos] = getScoreForEvaluate(i, j);
+            order.push_back(make_pair(-getOrderScore(i, j, rows, cols), pos));
+
+            //数字格子落子后就不再截断射线，所以只有到棋盘边缘的长度是固定的
+            for (int d = 0; d < 8; d++)
+            {
+                int len = 0;
+                for (int x = i + directions[d][0], y = j + directions[d][1]; inMat(x, y, rows, cols); x += directions[d][0], y += directions[d][1])
+                {
+                    len++;
+                }
+                if (len >= 2)
+                {
+                    mail_ray_dirs[pos] |= 1 << d;
+                }
+            }
+        }
+    }
+
+    //合法落子点按这个顺序生成，搜索时不需要再排序
+    stable_sort(order.begin(), order.end());
+    mail_cells.clear();
+    for (size_t k = 0; k < order.size(); k++)
+    {
+        mail_cells.push_back(order[k].second);
+    }
+}
+
+void loadMail(Player *player, MailBoard *board)
+{
+    memset(board->cell, MB_BORDER, sizeof(board->cell));
+    for (int i = 0; i < mail_rows; i++)
+    {
+        for (int j = 0; j < mail_cols; j++)
+        {
+            char c = player->mat[i][j];
+            int8_t cell = MB_EMPTY;
+            if (c == 'O')
+                cell = MB_OWN;
+            else if (c == 'o')
+                cell = MB_OPP;
+            else if (c >= '1' && c <= '9')
+                cell = MB_DIGIT;
+            board->cell[(i + 1) * mail_stride + j + 1] = cell;
+        }
+    }
+    board->your_score = player->your_score;
+    board->opponent_score = player->opponent_score;
+
+    mail_undo_top = mail_flip_top = mail_legal_top = 0;
+    board->legal_ply = 0;
+    memset(board->legal, 0, sizeof(board->legal));
+    board->mobility[0] = board->mobility[1] = 0;
+    for (size_t k = 0; k < mail_cells.size(); k++)
+    {
+        int pos = mail_cells[k];
+        if (board->cell[pos] == MB_EMPTY || board->cell[pos] == MB_DIGIT)
+        {
+            board->legal[pos] = getMailLegal(*board, pos);
+            board->mobility[0] += (board->legal[pos] & MB_LEGAL_OWN) != 0;
+            board->mobility[1] += (board->legal[pos] & MB_LEGAL_OPP) != 0;
+        }
+    }
+}
+
+bool isValidMail(const MailBoard &board, int pos, bool nowPlayer)
+{
+    return (board.legal[pos] & (nowPlayer ? MB_LEGAL_OWN : MB_LEGAL_OPP)) != 0;
+}
+
+//空格 pos 向 mail_dir[d] 方向的 legal：紧挨着的棋子决定能为哪一方夹住棋子，再往后找这一方的棋子
+inline uint16_t getMailRay(const MailBoard &board, int pos, int d)
+{
+    if (!((mail_ray_dirs[pos] >> d) & 1))
+    {
+        return 0;
+    }
+    int step = mail_dir[d];
+    int p = pos + step;
+    int8_t op = board.cell[p];
+    if (op != MB_OWN && op != MB_OPP)
+    {
+        return 0;
+    }
+    int8_t me = MB_OWN + MB_OPP - op;
+    //哨兵和数字格子都不小于 MB_DIGIT，走到它们就停下
+    for (p += step; board.cell[p] < MB_DIGIT; p += step)
+    {
+        if (board.cell[p] == me)
+        {
+            return me == MB_OWN ? 1 << d : 1 << (8 + d);
+        }
+    }
+    return 0;
+}
+
+uint16_t getMailLegal(const MailBoard &board, int pos)
+{
+    uint16_t legal = 0;
+    for (int d = 0; d < 8; d++)
+    {
+        legal |= getMailRay(board, pos, d);
+    }
+    return legal;
+}
+
+//修改一个格子的 legal，每次同步只在第一次修改时记录旧值，并更新行动力
+inline void setMailLegal(MailBoard *board, int pos, uint16_t legal)
+{
+    uint16_t old = board->legal[pos];
+    if (old == legal)
+    {
+        return;
+    }
+    if (mail_mark[pos] != mail_mark_now)
+    {
+        mail_mark[pos] = mail_mark_now;
+        mail_legal_pos[mail_legal_top] = pos;
+        mail_legal_old[mail_legal_top++] = old;
+    }
+    board->legal[pos] = legal;
+    board->mobility[0] += ((legal & MB_LEGAL_OWN) != 0) - ((old & MB_LEGAL_OWN) != 0);
+    board->mobility[1] += ((legal & MB_LEGAL_OPP) != 0) - ((old & MB_LEGAL_OPP) != 0);
+}
+
+void updateMailLegal(MailBoard *board, int changed)
+{
+    for (int d = 0; d < 8; d++)
+    {
+        //mail_dir 中 d 和 7 - d 方向相反
+        int step = mail_dir[d];
+        int back = 7 - d;
+        uint16_t back_mask = (1 << back) | (1 << (8 + back));
+        int seen = 0;
+        for (int p = changed + step; seen != (MB_OWN | MB_OPP); p += step)
+        {
+            int8_t cell = board->cell[p];
+            if (cell == MB_OWN || cell == MB_OPP)
+            {
+                seen |= cell;
+                continue;
+            }
+            if (cell == MB_BORDER)
+            {
+                break;
+            }
+            setMailLegal(board, p, (board->legal[p] & ~back_mask) | getMailRay(*board, p, back));
+            //数字格子本身可以落子，但截断了更远处空格的射线
+            if (cell == MB_DIGIT)
+            {
+                break;
+            }
+        }
     }
-    delete[] player->mat;
-    delete player;
 }
 
-bool isValid(Player *player, int posX, int posY, bool nowPlayer)
+void syncMailLegal(MailBoard *board)
 {
-    if (posX < 0 || posX >= player->row_cnt || posY < 0 || posY >= player->col_cnt)
+    if (board->legal_ply == mail_undo_top)
     {
-        return false;
+        return;
     }
-    if (player->mat[posX][posY] == 'o' || player->mat[posX][posY] == 'O')
+    //修改记录挂在最后一步上，撤销这一步时整批恢复
+    MailUndo &last = mail_undo[mail_undo_top - 1];
+    last.legal_begin = mail_legal_top;
+    last.legal_ply = board->legal_ply;
+    last.mobility[0] = board->mobility[0];
+    last.mobility[1] = board->mobility[1];
+    if (++mail_mark_now == 0)
     {
-        return false;
+        memset(mail_mark, 0, sizeof(mail_mark));
+        mail_mark_now = 1;
     }
-    vector<pair<int, int>> step = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}, {1, 1}, {-1, -1}, {1, -1}, {-1, 1}};
-    for (size_t i = 0; i < step.size(); ++i)
+    //几步的改变一起按当前棋局重新计算，结果与逐步计算相同
+    for (int i = board->legal_ply; i < mail_undo_top; i++)
     {
-        int dx = step[i].first;
-        int dy = step[i].second;
-        int x = posX + dx;
-        int y = posY + dy;
-        if (x < 0 || x >= player->row_cnt || y < 0 || y >= player->col_cnt)
+        const MailUndo &undo = mail_undo[i];
+        setMailLegal(board, undo.pos, 0);
+        updateMailLegal(board, undo.pos);
+        for (int k = undo.flip_begin; k < undo.flip_begin + undo.flip_cnt; k++)
         {
-            continue;
-        }
-        if ((nowPlayer && player->mat[x][y] != 'o') || (!nowPlayer && player->mat[x][y] != 'O'))
-        {
-            continue;
+            updateMailLegal(board, mail_flips[k]);
         }
-        while (true)
+    }
+    board->legal_ply = mail_undo_top;
+}
+
+int getMailMobility(MailBoard &board, bool nowPlayer)
+{
+    syncMailLegal(&board);
+    return board.mobility[nowPlayer ? 0 : 1];
+}
+
+int getMailMoves(MailBoard &board, bool nowPlayer, int *list)
+{
+    PROFILE_SCOPE(PROF_MOVES_MAIL, mail_undo_top);
+    syncMailLegal(&board);
+    int total = board.mobility[nowPlayer ? 0 : 1];
+    uint16_t side = nowPlayer ? MB_LEGAL_OWN : MB_LEGAL_OPP;
+    int cnt = 0;
+    for (size_t k = 0; cnt < total; k++)
+    {
+        if (board.legal[mail_cells[k]] & side)
         {
-            x += dx;
-            y += dy;
-            if (x < 0 || x >= player->row_cnt || y < 0 || y >= player->col_cnt || (player->mat[x][y] >= '1' && player->mat[x][y] <= '9'))
-            {
-                break;
-            }
-            if ((nowPlayer && player->mat[x][y] == 'O') || (!nowPlayer && player->mat[x][y] == 'o'))
-            {
-                return true;
-            }
+            list[cnt++] = mail_cells[k];
         }
     }
-    return false;
+    return cnt;
 }
 
-int getStable(vector<vector<int>> &board, int w_weight)
+int doStepMail(MailBoard *board, int pos, bool myself)
 {
-    int n = board.size();
-    int corner_weight = 0;
-    int steady_weight = 0;
-
-    int row = n - 1;
-    vector<vector<int>> corner_map = {
-        {0, 0, 1, 1},
-        {0, row, 1, -1},
-        {row, 0, -1, 1},
-        {row, row, -1, -1}};
+    PROFILE_SCOPE(PROF_DO_STEP_MAIL, mail_undo_top);
+    int8_t me = myself ? MB_OWN : MB_OPP;
+    int8_t op = myself ? MB_OPP : MB_OWN;
+    MailUndo &undo = mail_undo[mail_undo_top++];
+    undo.pos = pos;
+    undo.old = board->cell[pos];
+    undo.myself = myself;
+    undo.flip_begin = mail_flip_top;
+    board->cell[pos] = me;
 
-    for (auto &corner_data : corner_map)
+    int score = 0;
+    for (unsigned dirs = mail_ray_dirs[pos]; dirs; dirs &= dirs - 1)
     {
-        int corner_x = corner_data[0];
-        int corner_y = corner_data[1];
-        int dy = corner_data[2];
-        int dx = corner_data[3];
-
-        if (board[corner_x][corner_y] == 0)
+        int step = mail_dir[__builtin_ctz(dirs)];
+        int end = pos + step;
+        while (board->cell[end] == op)
         {
-            corner_weight += board[corner_x][corner_y + dx] * w_weight * -3;
-            corner_weight += board[corner_x + dy][corner_y] * w_weight * -3;
-            corner_weight += board[corner_x + dy][corner_y + dx] * w_weight * -6;
-
-            corner_weight += board[corner_x][corner_y + 2 * dx] * w_weight * 4;
-            corner_weight += board[corner_x + 2 * dy][corner_y] * w_weight * 4;
-            corner_weight += board[corner_x + dy][corner_y + 2 * dx] * w_weight * 2;
-            corner_weight += board[corner_x + 2 * dy][corner_y + dx] * w_weight * 2;
+            end += step;
         }
-        else
+        if (board->cell[end] != me)
         {
-            int i = corner_x;
-            int j = corner_y;
-            int current_score = board[corner_x][corner_y];
-
-            corner_weight += board[corner_x][corner_y] * w_weight * 15;
-
-            while (i >= 0 && i <= row && board[i][corner_y] == current_score)
-            {
-                steady_weight += w_weight * current_score;
-                i += dy;
-            }
-            while (j >= 0 && j <= row && board[corner_x][j] == current_score)
-            {
-                steady_weight += w_weight * current_score;
-                j += dx;
-            }
+            continue;
+        }
+        for (int p = pos + step; p != end; p += step)
+        {
+            board->cell[p] = me;
+            mail_flips[mail_flip_top++] = p;
+            score += mail_point_score[p];
         }
     }
-    if (n == 8)
-        return 14 * corner_weight + 12 * steady_weight;
-    else if (n == 10)
-        return 14 * corner_weight + 12 * steady_weight;
-    else if (n == 12 && strategy)
-        return 12 * corner_weight + 14 * steady_weight;
-    else
-        return 14 * corner_weight + 12 * steady_weight;
+
+    int point_score = mail_point_score[pos];
+    undo.flip_cnt = mail_flip_top - undo.flip_begin;
+    undo.your_delta = myself ? score + point_score : -score;
+    undo.opponent_delta = myself ? -score : score + point_score;
+    board->your_score += undo.your_delta;
+    board->opponent_score += undo.opponent_delta;
+    return score + point_score;
 }
 
-bool isFrontier(vector<vector<int>> &board, int i, int j)
+void undoStepMail(MailBoard *board)
 {
-    for (int dy = -1; dy <= 1; dy++)
+    MailUndo &undo = mail_undo[--mail_undo_top];
+    int8_t op = undo.myself ? MB_OPP : MB_OWN;
+    for (int i = undo.flip_begin; i < undo.flip_begin + undo.flip_cnt; i++)
     {
-        for (int dx = -1; dx <= 1; dx++)
+        board->cell[mail_flips[i]] = op;
+    }
+    mail_flip_top = undo.flip_begin;
+    if (board->legal_ply > mail_undo_top)
+    {
+        while (mail_legal_top > undo.legal_begin)
         {
-            if (!(dy == 0 && dx == 0) && board[i + dy][j + dx] != 0)
-            {
-                return true;
-            }
+            mail_legal_top--;
+            board->legal[mail_legal_pos[mail_legal_top]] = mail_legal_old[mail_legal_top];
         }
+        board->legal_ply = undo.legal_ply;
+        board->mobility[0] = undo.mobility[0];
+        board->mobility[1] = undo.mobility[1];
     }
-    return false;
+    board->cell[undo.pos] = undo.old;
+    board->your_score -= undo.your_delta;
+    board->opponent_score -= undo.opponent_delta;
 }
 
-int getFrontier(vector<vector<int>> &board, int w_weight)
+int evaluateMail(const MailBoard &board)
 {
-    int n = board[0].size();
-    int frontier_weight = 0;
+    PROFILE_SCOPE(PROF_EVAL_MAIL, mail_undo_top);
+    int row = mail_rows - 1;
+    int col = mail_cols - 1;
+    int corner_weight = 0;
+    int steady_weight = 0;
+    int corner_map[4][4] = {{0, 0, 1, 1}, {0, col, 1, -1}, {row, 0, -1, 1}, {row, col, -1, -1}};
 
-    for (int i = 1; i <= n - 2; i++)
+    for (int c = 0; c < 4; c++)
     {
-        for (int j = 1; j <= n - 2; j++)
+        int corner = (corner_map[c][0] + 1) * mail_stride + corner_map[c][1] + 1;
+        int dy = corner_map[c][2] * mail_stride;
+        int dx = corner_map[c][3];
+        int current_score = getMailValue(board, corner);
+
+        if (current_score == 0)
         {
-            if (board[i][j] != 0 && isFrontier(board, i, j))
+            corner_weight += getMailValue(board, corner + dx) * -3;
+            corner_weight += getMailValue(board, corner + dy) * -3;
+            corner_weight += getMailValue(board, corner + dy + dx) * -6;
+
+            corner_weight += getMailValue(board, corner + 2 * dx) * 4;
+            corner_weight += getMailValue(board, corner + 2 * dy) * 4;
+            corner_weight += getMailValue(board, corner + dy + 2 * dx) * 2;
+            corner_weight += getMailValue(board, corner + 2 * dy + dx) * 2;
+        }
+        else
+        {
+            //哨兵的值为 0，不等于 current_score，所以不用判断越界
+            corner_weight += current_score * 15;
+            for (int p = corner; getMailValue(board, p) == current_score; p += dy)
             {
-                frontier_weight -= board[i][j] * w_weight;
+                steady_weight += current_score;
+            }
+            for (int p = corner; getMailValue(board, p) == current_score; p += dx)
+            {
+                steady_weight += current_score;
             }
         }
     }
-    return frontier_weight;
-}
 
-int evaluate(Player *player)
-{
-    vector<vector<int>> board(player->row_cnt, vector<int>(player->col_cnt, 0));
-    for (int i = 0; i < player->row_cnt; i++)
+    int stable;
+    if (mail_rows == 12 && strategy)
+        stable = 12 * corner_weight + 14 * steady_weight;
+    else
+        stable = 14 * corner_weight + 12 * steady_weight;
+
+    int frontier_weight = 0;
+    for (int i = 2; i < mail_rows; i++)
     {
-        for (int j = 0; j < player->col_cnt; j++)
+        for (int j = 2; j < mail_cols; j++)
         {
-            if (player->mat[i][j] == 'O')
+            int pos = i * mail_stride + j;
+            int value = getMailValue(board, pos);
+            if (value == 0)
             {
-                board[i][j] = getScoreForEvaluate(i, j);
+                continue;
             }
-            else if (player->mat[i][j] == 'o')
+            for (int d = 0; d < 8; d++)
             {
-                board[i][j] = -getScoreForEvaluate(i, j);
+                if (getMailValue(board, pos + mail_dir[d]) != 0)
+                {
+                    frontier_weight -= value;
+                    break;
+                }
             }
         }
     }
 
-    int player_score = getStable(board, 1) + 4 * getFrontier(board, 1);
-    return player_score;
+    return stable + 4 * frontier_weight;
 }
 
-int alphaBeta(Player *player, int depth, int alpha, int beta, bool nowPlayer)
+int alphaBetaMail(MailBoard &board, int depth, int alpha, int beta, bool nowPlayer)
 {
-    vector<Point> valid_points;
-    for (int i = 0; i < player->row_cnt; i++)
+    if (checkTime())
     {
-        for (int j = 0; j < player->col_cnt; j++)
-        {
-            if (isValid(player, i, j, nowPlayer))
-            {
-                valid_points.push_back(initPoint(i, j));
-            }
-        }
+        return 0;
     }
     if (depth == 0)
     {
-        return evaluate(player);
+        return evaluateMail(board);
     }
-
-    if (valid_points.empty())
+    int list[MB_MAX_SIDE * MB_MAX_SIDE];
+    int cnt = getMailMoves(board, nowPlayer, list);
+    if (cnt == 0)
     {
-        return evaluate(player);
+        return evaluateMail(board);
     }
 
-    if (nowPlayer)
+    for (int i = 0; i < cnt; i++)
     {
-        for (size_t i = 0; i < valid_points.size(); ++i)
+        doStepMail(&board, list[i], nowPlayer);
+        int score = alphaBetaMail(board, depth - 1, alpha, beta, !nowPlayer);
+        undoStepMail(&board);
+        if (search_stop)
         {
-            Player *next_player = copyPlayer(player);
-            doStep(next_player, valid_points[i].X, valid_points[i].Y, 1);
-            int score = alphaBeta(next_player, depth - 1, alpha, beta, false);
+            return 0;
+        }
 
+        if (nowPlayer)
+        {
             alpha = max(alpha, score);
-
-            freePlayer(next_player);
-
-            if (beta <= alpha)
-            {
-                return beta;
-            }
         }
-        return alpha;
-    }
-    else
-    {
-        for (size_t i = 0; i < valid_points.size(); ++i)
+        else
         {
-            Player *next_player = copyPlayer(player);
-            doStep(next_player, valid_points[i].X, valid_points[i].Y, 0);
-
-            int score = alphaBeta(next_player, depth - 1, alpha, beta, true);
-
             beta = min(beta, score);
+        }
+        if (beta <= alpha)
+        {
+            return nowPlayer ? beta : alpha;
+        }
+    }
+    return nowPlayer ? alpha : beta;
+}
+
+Point placeMail(Player *player)
+{
+    search_clock::time_point start = search_clock::now();
+    MailBoard board;
+    loadMail(player, &board);
+    int list[MB_MAX_SIDE * MB_MAX_SIDE];
+    int cnt = getMailMoves(board, true, list);
+    int empty_cnt = 0;
+    for (size_t k = 0; k < mail_cells.size(); k++)
+    {
+        int pos = mail_cells[k];
+        empty_cnt += board.cell[pos] == MB_EMPTY || board.cell[pos] == MB_DIGIT;
+    }
+    int budget = getTimeBudget(empty_cnt);
+    search_deadline = start + chrono::milliseconds(budget);
+    search_stop = false;
+    search_nodes = 0;
 
-            freePlayer(next_player);
+    Point point = initPoint(-1, -1);
+    if (cnt > 0)
+    {
+        point = initPoint(list[0] / mail_stride - 1, list[0] % mail_stride - 1);
+    }
 
-            if (beta <= alpha)
+    int max_depth = min(min(empty_cnt, MAX_PLY), depth_limit);
+    int depth_done = 0;
+    for (int depth = 1; depth <= max_depth && cnt > 0; depth++)
+    {
+        int max_score = INT_MIN;
+        int best_index = 0;
+        for (int i = 0; i < cnt; i++)
+        {
+            doStepMail(&board, list[i], true);
+            int score = alphaBetaMail(board, depth - 1, INT_MIN, INT_MAX, false);
+            undoStepMail(&board);
+            if (search_stop)
             {
-                return alpha;
+                break;
+            }
+            if (score > max_score)
+            {
+                max_score = score;
+                best_index = i;
             }
         }
-        return beta;
+        if (search_stop)
+        {
+            break;
+        }
+        point = initPoint(list[best_index] / mail_stride - 1, list[best_index] % mail_stride - 1);
+        depth_done = depth;
+        search_report.score = max_score;
+        rotate(list, list + best_index, list + best_index + 1);
+
+        if (search_clock::now() - start > chrono::milliseconds(budget) / 2)
+        {
+            break;
+        }
+    }
+    search_stop = true;
+
+    game_time_used += chrono::duration_cast<chrono::milliseconds>(search_clock::now() - start).count();
+    if (move_cnt < (int)depth_log.size())
+    {
+        depth_log[move_cnt] = depth_done;
     }
+    search_report.source = "mailbox";
+    search_report.depth = depth_done;
+    return point;
 }
 
 void init(Player *player)
 {
+    //后台搜索用到的全局状态马上要重新分配，进程退出前也要先停下来
+    stopPonder();
+    ponder_key = 0;
+    ponder_depth = 0;
+    memset(game_history, 0, sizeof(game_history));
+    memset(game_killers, -1, sizeof(game_killers));
+    game_pv_len = 0;
+    game_last_valid = false;
+#if USE_PROFILE
+    //atexit 按注册的相反顺序调用，先注册 exitProfile 使它在 stopPonder 之后运行
+    if (!profile_registered)
+    {
+        profile_registered = true;
+        atexit(exitProfile);
+    }
+#endif
+    if (!ponder_registered)
+    {
+        atexit(stopPonder);
+        ponder_registered = true;
+    }
     std::random_device rd;
     std::mt19937 gen(rd());
     std::bernoulli_distribution dist(0.5); 
-    strategy = dist(gen);
+    strategy = FIXED_STRATEGY >= 0 ? FIXED_STRATEGY != 0 : dist(gen);
     for (int i = 0; i < player->row_cnt; i++)
     {
         vector<char> temp;
@@ -507,42 +4878,224 @@ void init(Player *player)
         }
         init_mat.push_back(temp);
     }
+
+    //搜索用到的缓冲区一次分配好，搜索过程中不再申请内存
+    int cells = player->row_cnt * player->col_cnt;
+    step_stack.assign(cells, StepRecord());
+    flip_stack.assign(cells * cells, 0);
+    ply_points.assign((MAX_PLY + 1) * cells, Point());
+    step_top = flip_top = 0;
+    depth_log.assign(cells, 0);
+    move_cnt = 0;
+    game_time_used = 0;
+    initBits(player);
+    if (bit_enabled)
+    {
+        initTT(TT_SIZE_MB);
+        EndEntry empty_entry = {0, -EG_INF, EG_INF, -1};
+        end_table.assign(1 << EG_HASH_BITS, empty_entry);
+        book_map_key = getMapKey(player);
+        book_active = loadBook(BOOK_FILE);
+        if (mcts_enabled && mcts_nodes.size() != MCTS_NODES)
+        {
+            mcts_nodes = vector<MctsNode>(MCTS_NODES);
+        }
+    }
+    initMail(player);
+
+    //遥测输出在整个进程中只打开一次，不关闭
+    const char *telemetry_path = TELEMETRY_FILE;
+    if (telemetry_file == NULL && telemetry_path[0] != '\0')
+    {
+        telemetry_file = strcmp(telemetry_path, "stderr") == 0 ? stderr : fopen(telemetry_path, "a");
+    }
 }
 
-Point place(Player *player)
+Point placeMatrix(Player *player)
 {
-    vector<Point> valid_points;
+    Point *valid_points = &ply_points[MAX_PLY * player->row_cnt * player->col_cnt];
+    int valid_cnt = 0;
     for (int i = 0; i < player->row_cnt; i++)
     {
         for (int j = 0; j < player->col_cnt; j++)
         {
             if (isValid(player, i, j, true))
             {
-                valid_points.push_back(initPoint(i, j));
+                valid_points[valid_cnt++] = initPoint(i, j);
             }
         }
     }
+    step_top = flip_top = 0;
 
     Point point = initPoint(-1, -1);
-    if (!valid_points.empty())
+    if (valid_cnt > 0)
     {
         int max_score = INT_MIN;
         int score = 0;
-        for (size_t i = 0; i < valid_points.size(); ++i)
+        for (int i = 0; i < valid_cnt; ++i)
         {
-            Player *next_player = copyPlayer(player);
-            doStep(next_player, valid_points[i].X, valid_points[i].Y, 1);
-            score = alphaBeta(next_player, MAX_DEPTH, INT_MIN, INT_MAX, false);
+            doStep(player, valid_points[i].X, valid_points[i].Y, 1);
+            score = alphaBeta(player, MAX_DEPTH, INT_MIN, INT_MAX, false);
+            undoStep(player);
 
             if (score > max_score)
             {
                 max_score = score;
                 point = valid_points[i];
             }
+        }
+        search_report.score = max_score;
+    }
+
+    search_report.source = "reference";
+    search_report.depth = valid_cnt > 0 ? MAX_DEPTH + 1 : 0;
+    return point;
+}
+
+#if USE_PROFILE
+void writeProfile(FILE *file)
+{
+    ProfileCounts total;
+    {
+        lock_guard<mutex> lock(profile_mutex);
+        total = profile_total;
+    }
+    long long calls[PROF_COUNT] = {}, cycles[PROF_COUNT] = {};
+    vector<pair<long long, int>> order; // (-周期数, 函数)，排序后周期数多的在前
+    for (int k = 0; k < PROF_COUNT; k++)
+    {
+        for (int ply = 0; ply < PROFILE_PLIES; ply++)
+        {
+            calls[k] += total.calls[k][ply];
+            cycles[k] += total.cycles[k][ply];
+        }
+        order.push_back(make_pair(-cycles[k], k));
+    }
+    sort(order.begin(), order.end());
 
-            freePlayer(next_player);
+    double place_cycles = max(1LL, cycles[PROF_PLACE]);
+    fprintf(file, "moves %d, place %.3f Gcycles\n", profile_moves, cycles[PROF_PLACE] / 1e9);
+    fprintf(file, "%-14s %6s %14s %16s %12s %8s\n", "function", "ply", "calls", "cycles", "cycles/call", "place%");
+    for (int i = 0; i < PROF_COUNT; i++)
+    {
+        int k = order[i].second;
+        if (calls[k] == 0)
+        {
+            continue;
+        }
+        fprintf(file, "%-14s %6s %14lld %16lld %12.1f %7.2f%%\n", profile_names[k], "all", calls[k], cycles[k],
+                (double)cycles[k] / calls[k], cycles[k] * 100.0 / place_cycles);
+        for (int ply = 0; ply < PROFILE_PLIES; ply++)
+        {
+            if (k == PROF_PLACE || total.calls[k][ply] == 0)
+            {
+                continue;
+            }
+            fprintf(file, "%-14s %5d%s %14lld %16lld %12.1f %7.2f%%\n", "", ply, ply == PROFILE_PLIES - 1 ? "+" : " ",
+                    total.calls[k][ply], total.cycles[k][ply], (double)total.cycles[k][ply] / total.calls[k][ply],
+                    total.cycles[k][ply] * 100.0 / place_cycles);
         }
     }
+}
+
+void saveProfile()
+{
+    const char *path = PROFILE_FILE;
+    if (strcmp(path, "stderr") == 0)
+    {
+        writeProfile(stderr);
+        return;
+    }
+    FILE *file = fopen(path, "w");
+    if (file != NULL)
+    {
+        writeProfile(file);
+        fclose(file);
+    }
+}
+
+void exitProfile()
+{
+    if (profile_writer.joinable())
+    {
+        profile_writer.join();
+    }
+    saveProfile();
+}
+#endif
+
+void writeTelemetry(Point point, long long us)
+{
+    long long nodes = search_nodes + helper_nodes;
+    fprintf(telemetry_file, "{\"move\":%d,\"source\":\"%s\",\"depth\":%d,\"nodes\":%lld,\"nps\":%.0f,\"ms\":%.3f,"
+            "\"tt_hit\":%.3f,\"cutoff\":%.3f,\"first_cutoff\":%.3f,\"x\":%d,\"y\":%d,",
+            move_cnt, search_report.source, search_report.depth, nodes, nodes * 1e6 / max(1LL, us), us / 1e3,
+            (double)tt_hits / max(1LL, tt_probes), (double)search_cutoffs / max(1LL, search_nodes),
+            (double)search_first_cutoffs / max(1LL, search_cutoffs), point.X, point.Y);
+    if (search_report.score == INT_MIN)
+        fprintf(telemetry_file, "\"score\":null,");
+    else
+        fprintf(telemetry_file, "\"score\":%d,", search_report.score);
+    fprintf(telemetry_file, "\"ponder_hit\":%s}\n", search_report.ponder_hit ? "true" : "false");
+    fflush(telemetry_file);
+}
+
+Point place(Player *player)
+{
+    search_clock::time_point start = search_clock::now();
+#if USE_PROFILE
+    uint64_t profile_start = profileCycles();
+#endif
+    SearchReport empty_report = {"none", 0, INT_MIN, false};
+    search_report = empty_report;
+    search_nodes = 0;
+    helper_nodes = 0;
+    tt_probes = tt_hits = 0;
+    search_cutoffs = search_first_cutoffs = 0;
+
+    Point point;
+#if USE_BITBOARD
+    if (bit_enabled)
+    {
+        point = mcts_enabled ? placeMcts(player) : placeBits(player);
+    }
+    else
+#endif
+#if USE_MAILBOX
+    if (mail_enabled)
+    {
+        point = placeMail(player);
+    }
+    else
+#endif
+    {
+        point = placeMatrix(player);
+    }
+    //步数在这里统一增加，char 矩阵的参考实现也计数，遥测中各条路径的步号一致
+    move_cnt++;
 
+    if (telemetry_file != NULL)
+    {
+        writeTelemetry(point, chrono::duration_cast<chrono::microseconds>(search_clock::now() - start).count());
+    }
+#if USE_PROFILE
+    //place 运行在每步新建的线程中，辅助线程已经退出，本线程的计数在这里并入
+    profile_thread.counts.calls[PROF_PLACE][0]++;
+    profile_thread.counts.cycles[PROF_PLACE][0] += profileCycles() - profile_start;
+    {
+        lock_guard<mutex> lock(profile_mutex);
+        addProfile(profile_total, profile_thread.counts);
+        profile_moves++;
+    }
+    //上一步的写出早已结束，join 几乎不花时间
+    if (strcmp(PROFILE_FILE, "stderr") != 0)
+    {
+        if (profile_writer.joinable())
+        {
+            profile_writer.join();
+        }
+        profile_writer = thread(saveProfile);
+    }
+#endif
     return point;
 }
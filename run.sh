@@ -7,6 +7,7 @@ WK_DIR=$(cd `dirname $0`; pwd)
 
 computer="$WK_DIR/bin/computer"
 player="$WK_DIR/bin/player"
+judge="$WK_DIR/bin/judge"
 log_dir="$WK_DIR/log/judge"
 
 map="$WK_DIR/data/map.txt"
@@ -40,4 +41,8 @@ make -s check_player || exit -1
 ./bin/check_player "$map"
 make -s computer || exit -1
 make -s player || exit -1
-./bin/judge --data_file="$map" --player_red="$computer" --player_blue="$player" --log_dir="$log_dir" --visible="$ok" || exit -1
+if [ "$FAST_JUDGE" == "1" ]; then
+    make -s fast_judge || exit -1
+    judge="$WK_DIR/bin/fast_judge"
+fi
+$judge --data_file="$map" --player_red="$computer" --player_blue="$player" --log_dir="$log_dir" --visible="$ok" || exit -1
@@ -0,0 +1,484 @@
+/**
+ * @file bench.c
+ * @brief 基准测试：make bench，或 ./bin/bench data/map*.txt
+ *
+ * 对每张地图按固定的伪随机序列下到 bench_stages 中的每个步数，得到一组固定的局面，
+ * 局面集合变化时增加 BENCH_VERSION。在每个局面上分别计时：
+ * isValid 遍历全盘生成落子、doStep/undoStep、evaluate、固定深度的 alphaBeta，
+ * 一维棋盘上对应的 getMailMoves、doStepMail/undoStepMail、alphaBetaMail，
+ * 以及位棋盘上对应的 getValidMask、doStepBits/undoStepBits、evaluateBits（另外计时增量维护的 evaluateIncr）、pvsBits，
+ * 轮到我方时再计时与 placeBits 相同的迭代加深（期望窗口）搜到同样深度，以及同样的时间限制下完成的深度（timed_bits），
+ * 并用 char 矩阵、一维棋盘和位棋盘分别做 perft，三者的叶子数必须相同。
+ * 每行输出一个 JSON 对象，便于不同版本之间比较。
+ */
+
+#define FIXED_STRATEGY 0 // 同一地图每次运行得到相同的结果
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../code/player.h"
+
+#define BENCH_VERSION 1     // 局面集合的版本号
+#define BENCH_MIN_NS 50000000LL // 每项计时至少运行的时间（纳秒）
+#define BENCH_AB_DEPTH 4    // char 矩阵 alphaBeta 的搜索深度
+#define BENCH_BITS_DEPTH 6  // 位棋盘 pvsBits 和迭代加深的搜索深度
+#define BENCH_PERFT_DEPTH 4 // perft 的深度，无子可下时跳过也算一层
+
+const int bench_stages[] = {0, 10, 20, 30}; // 取局面的步数
+
+volatile long long bench_sink = 0; // 防止被计时的调用被优化掉
+
+/**
+ * 读取地图文件，格式与 data/map*.txt 相同：第一行行数和列数，之后每行一个字符串
+ * @param[in] path 地图文件路径
+ * @return 初始棋局，读取失败时返回 NULL
+ */
+Player *readBenchMap(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    Player *player = new Player;
+    player->your_score = player->opponent_score = 0;
+    if (fscanf(file, "%d %d", &player->row_cnt, &player->col_cnt) != 2)
+    {
+        fclose(file);
+        delete player;
+        return NULL;
+    }
+    player->mat = new char *[player->row_cnt];
+    vector<char> line(player->col_cnt + 1);
+    for (int i = 0; i < player->row_cnt; i++)
+    {
+        player->mat[i] = new char[player->col_cnt];
+        if (fscanf(file, "%s", line.data()) != 1)
+        {
+            line.assign(player->col_cnt + 1, '0');
+        }
+        memcpy(player->mat[i], line.data(), player->col_cnt);
+    }
+    fclose(file);
+    return player;
+}
+
+/**
+ * 用 isValid 按行优先顺序列出所有合法落子点
+ * @return 落子点个数
+ */
+int listMoves(Player *player, bool nowPlayer, Point *points)
+{
+    int cnt = 0;
+    for (int i = 0; i < player->row_cnt; i++)
+    {
+        for (int j = 0; j < player->col_cnt; j++)
+        {
+            if (isValid(player, i, j, nowPlayer))
+            {
+                points[cnt++] = initPoint(i, j);
+            }
+        }
+    }
+    return cnt;
+}
+
+/**
+ * 从初始局面按固定的线性同余序列下 plies 步，一方无子可下时由另一方继续
+ * @param[in] player 初始棋局，原地修改
+ * @param[in] plies 要下的步数
+ * @param[in] seed 序列的种子，取地图指纹的低 32 位，与地图文件的顺序无关
+ * @param[out] nowPlayer 下完后轮到哪一方
+ * @return 实际下的步数，双方都无子可下时小于 plies
+ */
+int playStage(Player *player, int plies, uint32_t seed, bool *nowPlayer)
+{
+    vector<Point> points(player->row_cnt * player->col_cnt);
+    bool side = true;
+    for (int ply = 0; ply < plies; ply++)
+    {
+        int cnt = listMoves(player, side, points.data());
+        if (cnt == 0)
+        {
+            side = !side;
+            cnt = listMoves(player, side, points.data());
+            if (cnt == 0)
+            {
+                *nowPlayer = side;
+                return ply;
+            }
+        }
+        seed = seed * 1103515245u + 12345u;
+        Point point = points[(seed >> 16) % cnt];
+        doStep(player, point.X, point.Y, side);
+        side = !side;
+    }
+    *nowPlayer = side;
+    return plies;
+}
+
+/**
+ * char 矩阵上的 perft：统计 depth 层之后的叶子数，无子可下时跳过算一层，双方都不能下时是叶子
+ */
+long long perftMat(Player *player, int depth, bool nowPlayer, bool passed)
+{
+    if (depth == 0)
+    {
+        return 1;
+    }
+    Point *points = &ply_points[depth * player->row_cnt * player->col_cnt];
+    int cnt = listMoves(player, nowPlayer, points);
+    if (cnt == 0)
+    {
+        return passed ? 1 : perftMat(player, depth - 1, !nowPlayer, true);
+    }
+    long long nodes = 0;
+    for (int i = 0; i < cnt; i++)
+    {
+        doStep(player, points[i].X, points[i].Y, nowPlayer);
+        nodes += perftMat(player, depth - 1, !nowPlayer, false);
+        undoStep(player);
+    }
+    return nodes;
+}
+
+/**
+ * 一维棋盘上的 perft，规则与 perftMat 相同
+ */
+long long perftMail(MailBoard &board, int depth, bool nowPlayer, bool passed)
+{
+    if (depth == 0)
+    {
+        return 1;
+    }
+    int list[MB_MAX_SIDE * MB_MAX_SIDE];
+    int cnt = getMailMoves(board, nowPlayer, list);
+    if (cnt == 0)
+    {
+        return passed ? 1 : perftMail(board, depth - 1, !nowPlayer, true);
+    }
+    long long nodes = 0;
+    for (int i = 0; i < cnt; i++)
+    {
+        doStepMail(&board, list[i], nowPlayer);
+        nodes += perftMail(board, depth - 1, !nowPlayer, false);
+        undoStepMail(&board);
+    }
+    return nodes;
+}
+
+/**
+ * 位棋盘上的 perft，规则与 perftMat 相同
+ */
+long long perftBits(BitBoard &board, int depth, bool nowPlayer, bool passed)
+{
+    if (depth == 0)
+    {
+        return 1;
+    }
+    Bits moves = nowPlayer ? getValidMask(board.own, board.opp) : getValidMask(board.opp, board.own);
+    if (!bitAny(moves))
+    {
+        return passed ? 1 : perftBits(board, depth - 1, !nowPlayer, true);
+    }
+    long long nodes = 0;
+    while (bitAny(moves))
+    {
+        int pos = bitPop(moves);
+        doStepBits(&board, pos, nowPlayer);
+        nodes += perftBits(board, depth - 1, !nowPlayer, false);
+        undoStepBits(&board);
+    }
+    return nodes;
+}
+
+/**
+ * 重复调用 body 直到累计至少 BENCH_MIN_NS 纳秒
+ * @param[in] body 一轮被计时的代码，返回这一轮的调用次数
+ * @param[out] calls 总调用次数
+ * @return 总用时（纳秒）
+ */
+template <typename Body>
+long long timeLoop(Body body, long long *calls)
+{
+    search_clock::time_point start = search_clock::now();
+    long long elapsed = 0;
+    *calls = 0;
+    while (elapsed < BENCH_MIN_NS)
+    {
+        *calls += body();
+        elapsed = chrono::duration_cast<chrono::nanoseconds>(search_clock::now() - start).count();
+    }
+    return elapsed;
+}
+
+/**
+ * 输出一行计时结果
+ */
+void printCall(const char *map, int stage, const char *test, long long calls, long long ns)
+{
+    printf("{\"version\":%d,\"map\":\"%s\",\"strategy\":%d,\"stage\":%d,\"test\":\"%s\",\"calls\":%lld,\"ns_per_call\":%.1f}\n",
+           BENCH_VERSION, map, strategy, stage, test, calls, (double)ns / max(1LL, calls));
+}
+
+/**
+ * 输出一行固定深度搜索的结果
+ */
+void printSearch(const char *map, int stage, const char *test, int depth, int score, long long nodes, long long ns)
+{
+    printf("{\"version\":%d,\"map\":\"%s\",\"strategy\":%d,\"stage\":%d,\"test\":\"%s\",\"depth\":%d,\"score\":%d,\"nodes\":%lld,"
+           "\"ms\":%.3f,\"nps\":%.0f}\n",
+           BENCH_VERSION, map, strategy, stage, test, depth, score, nodes, ns / 1e6, nodes * 1e9 / max(1LL, ns));
+}
+
+/**
+ * 清空置换表和排序表，取消时间限制，之后的搜索结果只由局面决定
+ */
+void resetBitsSearch()
+{
+    initTT(TT_SIZE_MB);
+    memset(killer_moves, -1, sizeof(killer_moves));
+    memset(history_table, 0, sizeof(history_table));
+    search_deadline = search_clock::time_point::max();
+    search_stop = false;
+    search_nodes = 0;
+    bit_undo_top = 0;
+}
+
+/**
+ * 在一个局面上运行所有测试
+ * @param[in] map 地图文件路径，只用于输出
+ * @param[in] stage 局面所在的步数
+ * @param[in] player 当前棋局，返回时恢复原状
+ * @param[in] nowPlayer 当前轮到哪一方
+ * @return true perft 一致
+ */
+bool benchPosition(const char *map, int stage, Player *player, bool nowPlayer)
+{
+    int cells = player->row_cnt * player->col_cnt;
+    vector<Point> points(cells);
+    int cnt = listMoves(player, nowPlayer, points.data());
+    long long calls, ns;
+
+    ns = timeLoop([&]() { bench_sink += listMoves(player, nowPlayer, points.data()); return 1LL; }, &calls);
+    printCall(map, stage, "movegen", calls, ns);
+
+    if (cnt > 0)
+    {
+        ns = timeLoop([&]() {
+            for (int i = 0; i < cnt; i++)
+            {
+                bench_sink += doStep(player, points[i].X, points[i].Y, nowPlayer);
+                undoStep(player);
+            }
+            return (long long)cnt;
+        }, &calls);
+        printCall(map, stage, "dostep", calls, ns);
+    }
+
+    ns = timeLoop([&]() { bench_sink += evaluate(player); return 1LL; }, &calls);
+    printCall(map, stage, "evaluate", calls, ns);
+
+    search_nodes = 0;
+    search_clock::time_point start = search_clock::now();
+    int score = alphaBeta(player, BENCH_AB_DEPTH, INT_MIN, INT_MAX, nowPlayer);
+    ns = chrono::duration_cast<chrono::nanoseconds>(search_clock::now() - start).count();
+    printSearch(map, stage, "alphabeta", BENCH_AB_DEPTH, score, search_nodes, ns);
+
+    start = search_clock::now();
+    long long mat_nodes = perftMat(player, BENCH_PERFT_DEPTH, nowPlayer, false);
+    long long mat_ns = chrono::duration_cast<chrono::nanoseconds>(search_clock::now() - start).count();
+
+    bool ok = true;
+    if (mail_enabled)
+    {
+        MailBoard mail;
+        loadMail(player, &mail);
+        int list[MB_MAX_SIDE * MB_MAX_SIDE];
+        ns = timeLoop([&]() { bench_sink += getMailMoves(mail, nowPlayer, list); return 1LL; }, &calls);
+        printCall(map, stage, "movegen_mail", calls, ns);
+
+        int mail_cnt = getMailMoves(mail, nowPlayer, list);
+        if (mail_cnt > 0)
+        {
+            ns = timeLoop([&]() {
+                for (int i = 0; i < mail_cnt; i++)
+                {
+                    bench_sink += doStepMail(&mail, list[i], nowPlayer);
+                    undoStepMail(&mail);
+                }
+                return (long long)mail_cnt;
+            }, &calls);
+            printCall(map, stage, "dostep_mail", calls, ns);
+        }
+
+        search_deadline = search_clock::time_point::max();
+        search_stop = false;
+        search_nodes = 0;
+        start = search_clock::now();
+        score = alphaBetaMail(mail, BENCH_AB_DEPTH, INT_MIN, INT_MAX, nowPlayer);
+        ns = chrono::duration_cast<chrono::nanoseconds>(search_clock::now() - start).count();
+        printSearch(map, stage, "alphabeta_mail", BENCH_AB_DEPTH, score, search_nodes, ns);
+
+        start = search_clock::now();
+        long long mail_nodes = perftMail(mail, BENCH_PERFT_DEPTH, nowPlayer, false);
+        ns = chrono::duration_cast<chrono::nanoseconds>(search_clock::now() - start).count();
+        ok = mail_nodes == mat_nodes;
+        printf("{\"version\":%d,\"map\":\"%s\",\"strategy\":%d,\"stage\":%d,\"test\":\"perft_mail\",\"depth\":%d,\"nodes\":%lld,"
+               "\"mail_nodes\":%lld,\"mail_ms\":%.3f,\"ok\":%s}\n",
+               BENCH_VERSION, map, strategy, stage, BENCH_PERFT_DEPTH, mat_nodes, mail_nodes, ns / 1e6, ok ? "true" : "false");
+    }
+
+    if (!bit_enabled)
+    {
+        printf("{\"version\":%d,\"map\":\"%s\",\"strategy\":%d,\"stage\":%d,\"test\":\"perft\",\"depth\":%d,\"nodes\":%lld,\"ms\":%.3f}\n",
+               BENCH_VERSION, map, strategy, stage, BENCH_PERFT_DEPTH, mat_nodes, mat_ns / 1e6);
+        return ok;
+    }
+
+    BitBoard board = loadBits(player);
+    bit_undo_top = 0;
+    ns = timeLoop([&]() {
+        Bits moves = nowPlayer ? getValidMask(board.own, board.opp) : getValidMask(board.opp, board.own);
+        bench_sink += moves.w[0];
+        return 1LL;
+    }, &calls);
+    printCall(map, stage, "movegen_bits", calls, ns);
+
+    if (cnt > 0)
+    {
+        ns = timeLoop([&]() {
+            for (int i = 0; i < cnt; i++)
+            {
+                bench_sink += doStepBits(&board, points[i].X * bit_cols + points[i].Y, nowPlayer);
+                undoStepBits(&board);
+            }
+            return (long long)cnt;
+        }, &calls);
+        printCall(map, stage, "dostep_bits", calls, ns);
+    }
+
+    ns = timeLoop([&]() { bench_sink += evaluateBits(board); return 1LL; }, &calls);
+    printCall(map, stage, "evaluate_bits", calls, ns);
+    ns = timeLoop([&]() { bench_sink += evaluateIncr(board); return 1LL; }, &calls);
+    printCall(map, stage, "evaluate_incr", calls, ns);
+
+    //得分统一从我方看，与 alphabeta 的输出可以直接比较
+    resetBitsSearch();
+    start = search_clock::now();
+    score = pvsBits(board, BENCH_BITS_DEPTH, -SEARCH_INF, SEARCH_INF, nowPlayer);
+    ns = chrono::duration_cast<chrono::nanoseconds>(search_clock::now() - start).count();
+    printSearch(map, stage, "alphabeta_bits", BENCH_BITS_DEPTH, nowPlayer ? score : -score, search_nodes, ns);
+
+    Bits moves = getValidMask(board.own, board.opp);
+    if (nowPlayer && bitAny(moves))
+    {
+        resetBitsSearch();
+        int list[BB_MAX_CELLS];
+        int order[BB_MAX_CELLS];
+        start = search_clock::now();
+        int root_cnt = orderMoves(moves, -1, 0, true, list, order);
+        for (int i = 0; i < root_cnt; i++)
+        {
+            pickMove(list, order, root_cnt, i);
+        }
+        score = INT_MIN;
+        for (int depth = 1; depth <= BENCH_BITS_DEPTH; depth++)
+        {
+            int best_index;
+            score = searchAspiration(board, list, root_cnt, depth, score, &best_index);
+            rotate(list, list + best_index, list + best_index + 1);
+        }
+        ns = chrono::duration_cast<chrono::nanoseconds>(search_clock::now() - start).count();
+        printSearch(map, stage, "iterate_bits", BENCH_BITS_DEPTH, score, search_nodes, ns);
+
+        //与 placeBits 相同的时间限制（单线程）下完成的深度
+        resetBitsSearch();
+        start = search_clock::now();
+        search_deadline = start + chrono::milliseconds(time_limit_ms);
+        root_cnt = orderMoves(moves, -1, 0, true, list, order);
+        for (int i = 0; i < root_cnt; i++)
+        {
+            pickMove(list, order, root_cnt, i);
+        }
+        int empty_cnt = bitCount(bit_full & ~(board.own | board.opp));
+        int depth_done = 0;
+        score = INT_MIN;
+        for (int depth = 1; depth <= min(empty_cnt, MAX_PLY); depth++)
+        {
+            int best_index;
+            int value = searchAspiration(board, list, root_cnt, depth, score, &best_index);
+            if (search_stop)
+            {
+                break;
+            }
+            score = value;
+            depth_done = depth;
+            rotate(list, list + best_index, list + best_index + 1);
+            if (search_clock::now() - start > chrono::milliseconds(time_limit_ms) / 2)
+            {
+                break;
+            }
+        }
+        ns = chrono::duration_cast<chrono::nanoseconds>(search_clock::now() - start).count();
+        printSearch(map, stage, "timed_bits", depth_done, score, search_nodes, ns);
+        search_deadline = search_clock::time_point::max();
+        search_stop = false;
+    }
+
+    start = search_clock::now();
+    long long bits_nodes = perftBits(board, BENCH_PERFT_DEPTH, nowPlayer, false);
+    ns = chrono::duration_cast<chrono::nanoseconds>(search_clock::now() - start).count();
+    bool bits_ok = bits_nodes == mat_nodes;
+    printf("{\"version\":%d,\"map\":\"%s\",\"strategy\":%d,\"stage\":%d,\"test\":\"perft\",\"depth\":%d,\"nodes\":%lld,\"ms\":%.3f,"
+           "\"bits_nodes\":%lld,\"bits_ms\":%.3f,\"ok\":%s}\n",
+           BENCH_VERSION, map, strategy, stage, BENCH_PERFT_DEPTH, mat_nodes, mat_ns / 1e6, bits_nodes, ns / 1e6,
+           bits_ok ? "true" : "false");
+    return ok && bits_ok;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <map_file>...\n", argv[0]);
+        return 1;
+    }
+    bool ok = true;
+    for (int k = 1; k < argc; k++)
+    {
+        Player *player = readBenchMap(argv[k]);
+        if (player == NULL)
+        {
+            fprintf(stderr, "cannot read %s\n", argv[k]);
+            return 1;
+        }
+        init_mat.clear();
+        general_score = 0;
+        init(player);
+        uint32_t seed = (uint32_t)getMapKey(player);
+
+        for (size_t s = 0; s < sizeof(bench_stages) / sizeof(bench_stages[0]); s++)
+        {
+            step_top = flip_top = 0;
+            bool nowPlayer;
+            if (playStage(player, bench_stages[s], seed, &nowPlayer) < bench_stages[s])
+            {
+                break;
+            }
+            ok = benchPosition(argv[k], bench_stages[s], player, nowPlayer) && ok;
+            while (step_top > 0)
+            {
+                undoStep(player);
+            }
+        }
+        freePlayer(player);
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "perft mismatch between isValid/doStep and the mailbox or the bitboard\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,550 @@
+/**
+ * @file fast_judge.c
+ * @brief 无界面评测程序：make fast_judge && ./bin/fast_judge --data_file=data/map.txt --player_red=bin/computer
+ *        --player_blue=bin/player --log_dir=log/judge [--games=局数] [--jobs=并行数]
+ *
+ * 可以替换 bin/judge：参数相同（--visible 只为兼容，不显示界面），选手程序不需要重新编译，
+ * 通过 lib/libplayer.a 中 _work 的管道协议通信：
+ * 评测程序向选手发送 "行数 列数 每行的字符串 我方得分 对方得分 是否终局"，棋盘按选手的视角，自己的棋子为 'O'；
+ * 选手回复以 '\0' 结尾的 "pid 状态 ..."，状态 -2 为 init 的结果，0 后面是落子坐标 "X Y"，-1 表示超时或退出。
+ * 选手自己限制 init 1 秒、每步 100ms，评测程序只在选手没有回复时用 JUDGE_INIT_MS、JUDGE_PLACE_MS 兜底，
+ * 除此之外不等待，也不清屏。
+ *
+ * 每局在单独 fork 出的子进程中进行，最多同时进行 jobs 局；games 大于 1 时奇数局交换红蓝方。
+ * 选手程序默认使用全部核心并在对方思考时后台搜索，jobs 大于 1 时应换成单线程、不后台搜索的编译结果，
+ * 否则各局互相抢占时间。每局的日志写到 log_dir/judge.<局号>.log，
+ * 结束时按选手程序输出胜负、分差和每步用时（从发出棋盘到收到落子）的分布，只下一局时把双方得分写入 result.txt。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include "referee.h"
+
+using namespace std;
+
+#define JUDGE_INIT_MS 3000   // 等待 init 回复的最长时间（毫秒）
+#define JUDGE_PLACE_MS 1000  // 等待落子回复的最长时间（毫秒）
+#define JUDGE_FINISH_MS 200  // 终局后等待选手退出的时间（毫秒）
+#define JUDGE_DEAD_SCORE -100 // 非法落子、超时或异常退出的一方的得分，与 bin/judge 相同
+#define JUDGE_BUCKETS 10     // 用时分布的区间数
+
+//用时分布各区间的上界（毫秒），最后一个区间不设上界
+static const int judge_bucket_ms[JUDGE_BUCKETS - 1] = {1, 2, 5, 10, 20, 40, 60, 80, 100};
+
+/**
+ * 一个选手进程和与它通信的管道
+ */
+struct JudgePlayer
+{
+    pid_t pid;
+    int to_fd;     // 评测程序写，选手读
+    int from_fd;   // 选手写，评测程序读
+    string buffer; // 已读到但还不完整的回复
+};
+
+/**
+ * 子进程通过管道发回的一局结果，小于 PIPE_BUF，多个子进程同时写入不会交错。
+ * 下标 0 为 --player_red 指定的程序，1 为 --player_blue 指定的程序，与这一局谁执红无关
+ */
+struct JudgeResult
+{
+    int game;                        // 局号
+    int score[2];                    // 得分
+    int dead;                        // -1 正常终局，否则为被判负的程序
+    int moves;                       // 双方落子总数
+    int hist[2][JUDGE_BUCKETS];      // 每步用时的分布
+    int max_us[2];                   // 单步最长用时（微秒）
+    long long total_us[2];           // 总用时（微秒）
+};
+
+/**
+ * 启动选手程序，命令行与 bin/judge 相同：程序 读描述符 写描述符 playid
+ * @param[in] path 选手程序路径
+ * @param[in] playid 0 为红方，1 为蓝方
+ * @param[out] player 选手进程
+ * @return true 启动成功
+ */
+bool spawnPlayer(const char *path, int playid, JudgePlayer *player)
+{
+    int down[2], up[2];
+    if (pipe2(down, O_CLOEXEC) != 0)
+    {
+        return false;
+    }
+    if (pipe2(up, O_CLOEXEC) != 0)
+    {
+        close(down[0]);
+        close(down[1]);
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        //只有选手自己的两端留到 exec 之后，其他局和另一方的管道都会关闭
+        fcntl(down[0], F_SETFD, 0);
+        fcntl(up[1], F_SETFD, 0);
+        char read_fd[16], write_fd[16], id[16];
+        snprintf(read_fd, sizeof(read_fd), "%d", down[0]);
+        snprintf(write_fd, sizeof(write_fd), "%d", up[1]);
+        snprintf(id, sizeof(id), "%d", playid);
+        execl(path, path, read_fd, write_fd, id, (char *)NULL);
+        _exit(127);
+    }
+    close(down[0]);
+    close(up[1]);
+    if (pid < 0)
+    {
+        close(down[1]);
+        close(up[0]);
+        return false;
+    }
+    player->pid = pid;
+    player->to_fd = down[1];
+    player->from_fd = up[0];
+    player->buffer.clear();
+    return true;
+}
+
+/**
+ * 关闭管道并结束选手进程，包括它在 _work 中 fork 出的监视进程已经退出之后留下的进程
+ */
+void stopPlayer(JudgePlayer *player)
+{
+    if (player->pid <= 0)
+    {
+        return;
+    }
+    close(player->to_fd);
+    close(player->from_fd);
+    kill(player->pid, SIGKILL);
+    waitpid(player->pid, NULL, 0);
+    player->pid = -1;
+}
+
+/**
+ * 按 me 的视角生成发给选手的一帧，me 的棋子为 'O'，对方为 'o'
+ */
+string makeFrame(const MatchMap &map, const vector<string> &mat, char me, int your_score, int opponent_score, bool finish)
+{
+    string frame = to_string(map.row_cnt) + " " + to_string(map.col_cnt);
+    for (int i = 0; i < map.row_cnt; i++)
+    {
+        string row = mat[i];
+        if (me == 'o')
+        {
+            for (int j = 0; j < map.col_cnt; j++)
+            {
+                if (row[j] == 'O' || row[j] == 'o')
+                    row[j] = row[j] == 'O' ? 'o' : 'O';
+            }
+        }
+        frame += " " + row;
+    }
+    frame += " " + to_string(your_score) + " " + to_string(opponent_score) + " " + (finish ? "1" : "0");
+    return frame;
+}
+
+/**
+ * 发送一帧，_recv 只调用一次 read，所以一帧必须一次写完
+ */
+bool sendFrame(JudgePlayer *player, const string &frame)
+{
+    return write(player->to_fd, frame.c_str(), frame.size()) == (ssize_t)frame.size();
+}
+
+/**
+ * 读取一条以 '\0' 结尾的回复
+ * @param[in] player 选手进程
+ * @param[in] timeout_ms 最长等待时间（毫秒）
+ * @param[out] reply 回复，不含结尾的 '\0'
+ * @return false 超时或选手已经退出
+ */
+bool recvReply(JudgePlayer *player, int timeout_ms, string *reply)
+{
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout_ms);
+    while (true)
+    {
+        size_t end = player->buffer.find('\0');
+        if (end != string::npos)
+        {
+            *reply = player->buffer.substr(0, end);
+            player->buffer.erase(0, end + 1);
+            return true;
+        }
+        int left = (int)chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+        if (left < 0)
+        {
+            return false;
+        }
+        struct pollfd pfd = {player->from_fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, left);
+        if (ready < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ready <= 0)
+        {
+            return false;
+        }
+        char buf[256];
+        ssize_t got = read(player->from_fd, buf, sizeof(buf));
+        if (got <= 0)
+        {
+            return false;
+        }
+        player->buffer.append(buf, got);
+    }
+}
+
+/**
+ * 把一步的用时计入分布
+ */
+void recordLatency(JudgeResult *result, int who, long long us)
+{
+    int bucket = 0;
+    while (bucket < JUDGE_BUCKETS - 1 && us >= judge_bucket_ms[bucket] * 1000LL)
+    {
+        bucket++;
+    }
+    result->hist[who][bucket]++;
+    result->max_us[who] = max(result->max_us[who], (int)us);
+    result->total_us[who] += us;
+}
+
+/**
+ * 下一局，在子进程中调用
+ * @param[in] map 地图
+ * @param[in] path 两个选手程序，下标 0 为 --player_red，1 为 --player_blue
+ * @param[in] game 局号，奇数局交换红蓝方
+ * @param[in] log_dir 日志目录，为空时不写日志
+ * @return 对局结果
+ */
+JudgeResult playGame(const MatchMap &map, const char *const path[2], int game, const string &log_dir)
+{
+    JudgeResult result;
+    memset(&result, 0, sizeof(result));
+    result.game = game;
+    result.dead = -1;
+
+    FILE *log = NULL;
+    if (!log_dir.empty())
+    {
+        log = fopen((log_dir + "/judge." + to_string(game) + ".log").c_str(), "w");
+    }
+    int who[2];
+    who[0] = game % 2 == 0 ? 0 : 1; //红方先手，棋子为 'O'
+    who[1] = !who[0];
+    const char piece[2] = {'O', 'o'};
+    const char *name[2] = {"red", "blue"};
+
+    vector<string> mat = map.mat;
+    int score[2] = {0, 0};
+    JudgePlayer player[2];
+    int dead = -1; //被判负的一方，0 红方，1 蓝方
+    player[0].pid = player[1].pid = -1;
+    for (int side = 0; side < 2 && dead < 0; side++)
+    {
+        if (!spawnPlayer(path[who[side]], side, &player[side]))
+        {
+            if (log)
+                fprintf(log, "%s %s cannot start\n", name[side], path[who[side]]);
+            dead = side;
+            break;
+        }
+        string frame = makeFrame(map, mat, piece[side], 0, 0, false);
+        string reply;
+        if (log)
+            fprintf(log, "buf value: %s\n", frame.c_str());
+        if (!(sendFrame(&player[side], frame) && recvReply(&player[side], JUDGE_INIT_MS, &reply) &&
+                  reply.find("init success") != string::npos))
+        {
+            if (log)
+                fprintf(log, "%s init failed: %s\n", name[side], reply.c_str());
+            dead = side;
+        }
+        else if (log)
+        {
+            fprintf(log, "%s %s init success\n", name[side], path[who[side]]);
+        }
+    }
+
+    int side = 0;
+    while (dead < 0)
+    {
+        if (!refereeCanMove(map, mat, piece[side]))
+        {
+            if (!refereeCanMove(map, mat, piece[!side]))
+            {
+                break;
+            }
+            side = !side;
+        }
+        string frame = makeFrame(map, mat, piece[side], score[side], score[!side], false);
+        string reply;
+        if (log)
+            fprintf(log, "buf value: %s\n", frame.c_str());
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        bool ok = sendFrame(&player[side], frame) && recvReply(&player[side], JUDGE_PLACE_MS, &reply);
+        long long us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+        recordLatency(&result, who[side], us);
+
+        int pid, status, x = -1, y = -1;
+        if (!ok || sscanf(reply.c_str(), "%d %d %d %d", &pid, &status, &x, &y) != 4 || status != 0)
+        {
+            if (log)
+                fprintf(log, "%s timed out or exited: %s\n", name[side], reply.c_str());
+            dead = side;
+            break;
+        }
+        if (log)
+            fprintf(log, "%s place (%d,%d) %lld us\n", name[side], x, y, us);
+        if (!refereeValid(map, mat, x, y, piece[side]))
+        {
+            if (log)
+                fprintf(log, "%s move wrong and died\n", name[side]);
+            dead = side;
+            break;
+        }
+        int flipped;
+        score[side] += refereeStep(map, mat, x, y, piece[side], &flipped);
+        score[!side] -= flipped;
+        result.moves++;
+        side = !side;
+    }
+    if (dead >= 0)
+    {
+        score[dead] = JUDGE_DEAD_SCORE;
+    }
+
+    //终局帧让选手正常退出，之后不再等待
+    for (int s = 0; s < 2; s++)
+    {
+        if (player[s].pid > 0)
+        {
+            string frame = makeFrame(map, mat, piece[s], score[s], score[!s], true);
+            string reply;
+            if (log)
+                fprintf(log, "buf value: %s\n", frame.c_str());
+            if (sendFrame(&player[s], frame))
+            {
+                recvReply(&player[s], JUDGE_FINISH_MS, &reply);
+            }
+            stopPlayer(&player[s]);
+        }
+        if (log)
+            fprintf(log, "%s %s get %d scores\n", name[s], path[who[s]], score[s]);
+    }
+    if (log)
+    {
+        fclose(log);
+    }
+
+    for (int s = 0; s < 2; s++)
+    {
+        result.score[who[s]] = score[s];
+    }
+    result.dead = dead < 0 ? -1 : who[dead];
+    return result;
+}
+
+/**
+ * 解析 --name=value 形式的参数，不带值的 --name 视为 "true"
+ * @return true 参数名为 name
+ */
+bool parseFlag(const char *arg, const char *name, string *value)
+{
+    size_t len = strlen(name);
+    if (strncmp(arg, "--", 2) != 0 || strncmp(arg + 2, name, len) != 0)
+    {
+        return false;
+    }
+    if (arg[2 + len] == '=')
+    {
+        *value = arg + 3 + len;
+        return true;
+    }
+    if (arg[2 + len] == '\0')
+    {
+        *value = "true";
+        return true;
+    }
+    return false;
+}
+
+/**
+ * 一个选手程序的累计结果
+ */
+struct JudgeStats
+{
+    int wins;
+    int draws;
+    int losses;
+    int deaths;
+    long long margin; // 分差之和
+    int hist[JUDGE_BUCKETS];
+    int max_us;
+    long long total_us;
+};
+
+/**
+ * 输出一个选手程序的胜负、分差和每步用时分布
+ */
+void printJudgeStats(const char *path, const JudgeStats &stats)
+{
+    int n = stats.wins + stats.draws + stats.losses;
+    int moves = 0;
+    for (int b = 0; b < JUDGE_BUCKETS; b++)
+    {
+        moves += stats.hist[b];
+    }
+    printf("%s\n  games %d  W/D/L %d/%d/%d  died %d  margin %+.2f\n", path, n, stats.wins, stats.draws,
+           stats.losses, stats.deaths, n > 0 ? (double)stats.margin / n : 0.0);
+    printf("  moves %d  mean %.2f ms  max %.2f ms\n ", moves, moves > 0 ? stats.total_us / 1000.0 / moves : 0.0,
+           stats.max_us / 1000.0);
+    for (int b = 0; b < JUDGE_BUCKETS; b++)
+    {
+        if (b < JUDGE_BUCKETS - 1)
+            printf(" <%dms %d", judge_bucket_ms[b], stats.hist[b]);
+        else
+            printf(" >=%dms %d", judge_bucket_ms[b - 1], stats.hist[b]);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    string data_file, path[2], log_dir, value;
+    int games = 1;
+    int jobs = 1;
+    for (int k = 1; k < argc; k++)
+    {
+        if (parseFlag(argv[k], "data_file", &data_file) || parseFlag(argv[k], "player_red", &path[0]) ||
+            parseFlag(argv[k], "player_blue", &path[1]) || parseFlag(argv[k], "log_dir", &log_dir) ||
+            parseFlag(argv[k], "visible", &value))
+        {
+            continue;
+        }
+        if (parseFlag(argv[k], "games", &value))
+        {
+            games = max(1, atoi(value.c_str()));
+            continue;
+        }
+        if (parseFlag(argv[k], "jobs", &value))
+        {
+            jobs = max(1, atoi(value.c_str()));
+            continue;
+        }
+        fprintf(stderr, "unknown argument %s\n", argv[k]);
+        return 1;
+    }
+    if (data_file.empty() || path[0].empty() || path[1].empty())
+    {
+        fprintf(stderr, "usage: %s --data_file=<map> --player_red=<program> --player_blue=<program> "
+                        "[--log_dir=<dir>] [--games=<n>] [--jobs=<n>]\n", argv[0]);
+        return 1;
+    }
+    MatchMap map;
+    if (!readMatchMap(data_file.c_str(), &map))
+    {
+        fprintf(stderr, "cannot read %s\n", data_file.c_str());
+        return 1;
+    }
+    if (!log_dir.empty())
+    {
+        mkdir(log_dir.c_str(), 0755);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0)
+    {
+        perror("pipe");
+        return 1;
+    }
+    fflush(stdout);
+    fflush(stderr);
+
+    const char *paths[2] = {path[0].c_str(), path[1].c_str()};
+    JudgeStats stats[2];
+    memset(stats, 0, sizeof(stats));
+    int started = 0, running = 0;
+    int last_score[2] = {0, 0};
+    while (running > 0 || started < games)
+    {
+        while (started < games && running < jobs)
+        {
+            pid_t pid = fork();
+            if (pid < 0)
+            {
+                perror("fork");
+                return 1;
+            }
+            if (pid == 0)
+            {
+                close(fds[0]);
+                JudgeResult result = playGame(map, paths, started, log_dir);
+                ssize_t written = write(fds[1], &result, sizeof(result));
+                _exit(written == (ssize_t)sizeof(result) ? 0 : 1);
+            }
+            started++;
+            running++;
+        }
+
+        JudgeResult result;
+        if (read(fds[0], &result, sizeof(result)) != (ssize_t)sizeof(result))
+        {
+            fprintf(stderr, "lost a game result\n");
+            return 1;
+        }
+        wait(NULL);
+        running--;
+
+        printf("game %d  %s %d  %s %d%s\n", result.game, paths[0], result.score[0], paths[1], result.score[1],
+               result.dead >= 0 ? (result.dead == 0 ? "  (red program died)" : "  (blue program died)") : "");
+        fflush(stdout);
+        for (int who = 0; who < 2; who++)
+        {
+            int margin = result.score[who] - result.score[!who];
+            if (result.dead == who || (result.dead < 0 && margin < 0))
+                stats[who].losses++;
+            else if (result.dead == !who || margin > 0)
+                stats[who].wins++;
+            else
+                stats[who].draws++;
+            stats[who].deaths += result.dead == who;
+            stats[who].margin += margin;
+            for (int b = 0; b < JUDGE_BUCKETS; b++)
+            {
+                stats[who].hist[b] += result.hist[who][b];
+            }
+            stats[who].max_us = max(stats[who].max_us, result.max_us[who]);
+            stats[who].total_us += result.total_us[who];
+            last_score[who] = result.score[who];
+        }
+    }
+    printJudgeStats(paths[0], stats[0]);
+    printJudgeStats(paths[1], stats[1]);
+
+    if (games == 1)
+    {
+        FILE *file = fopen("result.txt", "w");
+        if (file != NULL)
+        {
+            fprintf(file, "%d %d\n", last_score[0], last_score[1]);
+            fclose(file);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,558 @@
+/**
+ * @file fit_eval.c
+ * @brief 离线拟合模式表：make fit && ./bin/fit data/eval.bin 1000 2 data/map*.txt
+ *
+ * 对每张地图自我对局 games 局，双方都用 pvsBits 搜索固定深度 depth，
+ * 前 FIT_RANDOM_PLIES 步和之后 FIT_EPSILON 的概率随机落子，让局面足够分散。
+ * 每个局面记录所有模式（包括手写评估中没有的对角线）的三进制下标、手写评估值和终局分差，都从我方看，
+ * 棋子颜色对调后再记一次，这样拟合值对双方对称。
+ * 先用最小二乘求终局分差对手写评估的系数 a，再用随机梯度下降拟合每种模式每个下标的值去解释剩下的部分，
+ * 最后除以 a 换算成手写评估的单位，写成 EvalHeader 加上若干段 EvalSection 和拟合值。
+ * 每 FIT_HOLDOUT 局留出一局不参与拟合，用来比较拟合前后的误差。
+ *
+ * ./bin/fit --probcut data/eval.bin 20 data/map*.txt 拟合 player.h 中 ProbCut 的 probcut_fit：
+ * 同样自我对局取局面，在每个局面上关闭 ProbCut 迭代加深到 PROBCUT_MAX_DEPTH，
+ * 对每对深度用最小二乘拟合深层得分对浅层得分的直线，
+ * 输出各张地图和合并后的残差标准差，以及浅层比深层少 FIT_PROBCUT_REDUCTION 层、可以直接粘贴的 probcut_fit 初值。
+ */
+
+#define EVAL_FILE "" // 对局和特征都只用手写评估
+#define FIXED_STRATEGY 0 // 同样的参数总是得到同样的拟合结果
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+
+#include "../code/player.h"
+
+#define FIT_RANDOM_PLIES 8 // 开局随机落子的步数
+#define FIT_EPSILON 0.1    // 之后随机落子的概率
+#define FIT_EPOCHS 20      // 随机梯度下降的轮数
+#define FIT_RATE 0.02      // 学习率，按样本特征的平方和归一化
+#define FIT_L2 1e-4        // 每次更新时拟合值向 0 收缩的比例
+#define FIT_MIN_COUNT 32   // 训练样本中出现次数少于这个数的下标不写出拟合值
+#define FIT_HOLDOUT 10     // 每 10 局留出 1 局做验证
+#define FIT_PROBCUT_REDUCTION 2 // 输出的 probcut_fit 中浅层搜索少的层数，与深层的奇偶性相同
+#define FIT_PROBCUT_EVERY 4    // 拟合 ProbCut 时每隔几步取一个局面
+#define FIT_PROBCUT_MS 3000    // 拟合 ProbCut 时每个局面的搜索时间上限（毫秒），没搜完的深度不计入
+
+/**
+ * 一个训练样本：每个模式对应一个特征，特征值是模式格子的平均分数
+ */
+struct FitSample
+{
+    int feature[EVAL_MAX_PATTERNS]; // 特征在拟合值数组中的下标
+    float weight[EVAL_MAX_PATTERNS]; // 特征值
+    int cnt;                        // 特征个数
+    float hand;                     // 手写评估值
+    float target;                   // 终局分差
+    bool holdout;                   // 是否留作验证
+};
+
+/**
+ * 拟合 ProbCut 时取的一个局面
+ */
+struct FitPosition
+{
+    BitBoard board;
+    bool nowPlayer;
+};
+
+/**
+ * 一对深度的最小二乘累加量，x 为浅层得分，y 为深层得分
+ */
+struct FitLine
+{
+    double n, sx, sy, sxx, sxy, syy;
+};
+
+map<pair<int, int>, int> fit_base; // 每种 (模式种类, 长度) 的拟合值在 fit_value 中的起始位置
+vector<double> fit_value;          // 所有拟合值，单位是终局分差
+vector<int> fit_count;             // 每个拟合值在训练样本中出现的次数
+
+/**
+ * 读取地图文件，格式与 data/map*.txt 相同：第一行行数和列数，之后每行一个字符串
+ * @param[in] path 地图文件路径
+ * @return 初始棋局，读取失败时返回 NULL
+ */
+Player *readMap(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    Player *player = new Player;
+    player->your_score = player->opponent_score = 0;
+    if (fscanf(file, "%d %d", &player->row_cnt, &player->col_cnt) != 2)
+    {
+        fclose(file);
+        delete player;
+        return NULL;
+    }
+    player->mat = new char *[player->row_cnt];
+    vector<char> line(player->col_cnt + 1);
+    for (int i = 0; i < player->row_cnt; i++)
+    {
+        player->mat[i] = new char[player->col_cnt];
+        if (fscanf(file, "%s", line.data()) != 1)
+        {
+            line.assign(player->col_cnt + 1, '0');
+        }
+        memcpy(player->mat[i], line.data(), player->col_cnt);
+    }
+    fclose(file);
+    return player;
+}
+
+/**
+ * 固定深度搜索一方的最优落子，与 searchRoot 相同但不限定轮到我方
+ * @param[in] board 位棋盘表示的棋局，返回时恢复原状
+ * @param[in] moves 合法落子点的集合，不为空
+ * @param[in] depth 搜索深度，包含这一步
+ * @param[in] nowPlayer 当前是否轮到我方
+ * @return 最优落子位置
+ */
+int searchMove(BitBoard &board, Bits moves, int depth, bool nowPlayer)
+{
+    int list[BB_MAX_CELLS];
+    int order[BB_MAX_CELLS];
+    int cnt = orderMoves(moves, -1, 0, nowPlayer, list, order);
+    int best = -1;
+    int alpha = -SEARCH_INF;
+    for (int i = 0; i < cnt; i++)
+    {
+        int pos = pickMove(list, order, cnt, i);
+        doStepBits(&board, pos, nowPlayer);
+        int score = -pvsBits(board, depth - 1, -SEARCH_INF, -alpha, !nowPlayer);
+        undoStepBits(&board);
+        if (best < 0 || score > alpha)
+        {
+            alpha = score;
+            best = pos;
+        }
+    }
+    return best;
+}
+
+/**
+ * 把模式下标中的我方和对方对调
+ */
+int swapIndex(int index, int len)
+{
+    int swapped = 0;
+    for (int k = 0; k < len; k++, index /= 3)
+    {
+        int digit = index % 3;
+        swapped += (digit == 0 ? 0 : 3 - digit) * pow3[k];
+    }
+    return swapped;
+}
+
+/**
+ * 记录局面的特征，swap 为 true 时对调双方
+ */
+FitSample makeSample(const BitBoard &board, bool swap, bool holdout)
+{
+    FitSample sample;
+    sample.cnt = 0;
+    for (int p = 0; p < eval_pattern_cnt; p++)
+    {
+        int len = eval_pattern_len[p];
+        pair<int, int> key(eval_pattern_type[p], len);
+        if (fit_base.count(key) == 0)
+        {
+            fit_base[key] = (int)fit_value.size();
+            fit_value.resize(fit_value.size() + pow3[len], 0);
+            fit_count.resize(fit_value.size(), 0);
+        }
+        int index = getPatternIndex(board, p);
+        double weight = 0;
+        for (int k = 0; k < len; k++)
+        {
+            weight += bit_eval_score[eval_pattern_cells[p][k]];
+        }
+        sample.feature[sample.cnt] = fit_base[key] + (swap ? swapIndex(index, len) : index);
+        sample.weight[sample.cnt] = (float)(weight / len);
+        sample.cnt++;
+    }
+    sample.hand = (float)(swap ? -evaluateBits(board) : evaluateBits(board));
+    sample.holdout = holdout;
+    return sample;
+}
+
+/**
+ * 自我对局一局，把经过的局面加入 samples，终局后补上分差；positions 不为 NULL 时每隔 FIT_PROBCUT_EVERY 步另外记下局面
+ */
+void playGame(const BitBoard &start, int depth, bool holdout, mt19937 &rng, vector<FitSample> &samples,
+              vector<FitPosition> *positions)
+{
+    BitBoard board = start;
+    size_t first = samples.size();
+    uniform_real_distribution<double> coin(0, 1);
+    bool nowPlayer = true;
+    int passes = 0;
+    for (int ply = 0; passes < 2; ply++)
+    {
+        Bits moves = nowPlayer ? getValidMask(board.own, board.opp) : getValidMask(board.opp, board.own);
+        int cnt = bitCount(moves);
+        if (cnt == 0)
+        {
+            passes++;
+            nowPlayer = !nowPlayer;
+            continue;
+        }
+        passes = 0;
+        if (positions != NULL)
+        {
+            if (ply >= FIT_RANDOM_PLIES && ply % FIT_PROBCUT_EVERY == 0)
+            {
+                FitPosition position = {board, nowPlayer};
+                positions->push_back(position);
+            }
+        }
+        else
+        {
+            samples.push_back(makeSample(board, false, holdout));
+            samples.push_back(makeSample(board, true, holdout));
+        }
+
+        int pos;
+        if (ply < FIT_RANDOM_PLIES || coin(rng) < FIT_EPSILON)
+        {
+            for (int k = (int)(rng() % cnt); k > 0; k--)
+            {
+                bitPop(moves);
+            }
+            pos = bitPop(moves);
+        }
+        else
+        {
+            pos = searchMove(board, moves, depth, nowPlayer);
+        }
+        //真实落子不会撤销，撤销栈只留给搜索用
+        doStepBits(&board, pos, nowPlayer);
+        bit_undo_top = 0;
+        nowPlayer = !nowPlayer;
+    }
+
+    float diff = (float)(board.your_score - board.opponent_score);
+    for (size_t i = first; i < samples.size(); i++)
+    {
+        samples[i].target = (i - first) % 2 == 0 ? diff : -diff;
+    }
+}
+
+double predictFitted(const FitSample &sample)
+{
+    double pred = 0;
+    for (int i = 0; i < sample.cnt; i++)
+    {
+        pred += fit_value[sample.feature[i]] * sample.weight[i];
+    }
+    return pred;
+}
+
+/**
+ * 训练集或验证集上的均方根误差
+ */
+double getRmse(const vector<FitSample> &samples, bool holdout, double a, bool fitted)
+{
+    double sum = 0;
+    long long n = 0;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        if (samples[i].holdout != holdout)
+        {
+            continue;
+        }
+        double err = samples[i].target - a * samples[i].hand - (fitted ? predictFitted(samples[i]) : 0);
+        sum += err * err;
+        n++;
+    }
+    return sqrt(sum / max(1LL, n));
+}
+
+/**
+ * 由累加量求直线 y = a * x + b 和残差的标准差
+ */
+void solveLine(const FitLine &line, double *a, double *b, double *sigma)
+{
+    double n = max(1.0, line.n);
+    double var_x = line.sxx / n - (line.sx / n) * (line.sx / n);
+    double cov = line.sxy / n - (line.sx / n) * (line.sy / n);
+    *a = var_x > 0 ? cov / var_x : 0;
+    *b = line.sy / n - *a * line.sx / n;
+    double res = line.syy / n - 2 * *a * line.sxy / n - 2 * *b * line.sy / n + *a * *a * line.sxx / n +
+                 2 * *a * *b * line.sx / n + *b * *b;
+    *sigma = sqrt(max(0.0, res));
+}
+
+/**
+ * 拟合 ProbCut 的模型并输出，参数与 main 相同但去掉开头的 --probcut
+ */
+int fitProbCut(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: fit --probcut <eval_file> <games_per_map> <map_file>...\n");
+        return 1;
+    }
+    int games = atoi(argv[1]);
+    static FitLine total[PROBCUT_MAX_DEPTH + 1][PROBCUT_MAX_DEPTH + 1];
+    for (int k = 2; k < argc; k++)
+    {
+        Player *player = readMap(argv[k]);
+        if (player == NULL)
+        {
+            fprintf(stderr, "cannot read %s\n", argv[k]);
+            return 1;
+        }
+        init_mat.clear();
+        general_score = 0;
+        init(player);
+        if (!bit_enabled)
+        {
+            fprintf(stderr, "%s: board too large for the bitboard, skipped\n", argv[k]);
+            freePlayer(player);
+            continue;
+        }
+        //模式表文件要在 initPatterns 算好 pow3 之后才能载入，载入后重建一次，之后的地图 init 时直接使用
+        if (eval_file == NULL)
+        {
+            if (!loadEvalFile(argv[0]))
+            {
+                fprintf(stderr, "cannot load %s, fitting the hand evaluation\n", argv[0]);
+            }
+            initPatterns();
+        }
+        probcut_enabled = false;
+        search_deadline = search_clock::time_point::max();
+        search_stop = false;
+        mt19937 rng((uint32_t)getMapKey(player));
+        BitBoard start = loadBits(player);
+        vector<FitSample> samples;
+        vector<FitPosition> positions;
+        for (int g = 0; g < games; g++)
+        {
+            playGame(start, 2, false, rng, samples, &positions);
+        }
+
+        static FitLine lines[PROBCUT_MAX_DEPTH + 1][PROBCUT_MAX_DEPTH + 1];
+        memset(lines, 0, sizeof(lines));
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            //与 placeBits 一样迭代加深，置换表和排序表沿用浅层的结果
+            BitBoard board = positions[i].board;
+            int empty_cnt = bitCount(bit_full & ~(board.own | board.opp));
+            int max_depth = min(PROBCUT_MAX_DEPTH, empty_cnt - 1);
+            double score[PROBCUT_MAX_DEPTH + 1];
+            int done = 0;
+            tt_age++;
+            bit_undo_top = 0;
+            search_stop = false;
+            search_deadline = search_clock::now() + chrono::milliseconds(FIT_PROBCUT_MS);
+            for (int depth = 1; depth <= max_depth; depth++)
+            {
+                int value = pvsBits(board, depth, -SEARCH_INF, SEARCH_INF, positions[i].nowPlayer);
+                if (search_stop)
+                {
+                    break;
+                }
+                score[depth] = value;
+                done = depth;
+            }
+            for (int depth = 2; depth <= done; depth++)
+            {
+                for (int shallow = 1; shallow < depth; shallow++)
+                {
+                    double x = score[shallow], y = score[depth];
+                    FitLine &line = lines[depth][shallow];
+                    line.n++;
+                    line.sx += x;
+                    line.sy += y;
+                    line.sxx += x * x;
+                    line.sxy += x * y;
+                    line.syy += y * y;
+                }
+            }
+        }
+        search_deadline = search_clock::time_point::max();
+
+        fprintf(stderr, "%s: %zu positions, sigma for shallow = depth - %d:", argv[k], positions.size(),
+                FIT_PROBCUT_REDUCTION);
+        for (int depth = FIT_PROBCUT_REDUCTION + 1; depth <= PROBCUT_MAX_DEPTH; depth++)
+        {
+            double a, b, sigma;
+            solveLine(lines[depth][depth - FIT_PROBCUT_REDUCTION], &a, &b, &sigma);
+            fprintf(stderr, " %.2f", sigma);
+        }
+        fprintf(stderr, "\n");
+        for (int depth = 0; depth <= PROBCUT_MAX_DEPTH; depth++)
+        {
+            for (int shallow = 0; shallow <= PROBCUT_MAX_DEPTH; shallow++)
+            {
+                FitLine &line = total[depth][shallow];
+                const FitLine &add = lines[depth][shallow];
+                line.n += add.n;
+                line.sx += add.sx;
+                line.sy += add.sy;
+                line.sxx += add.sxx;
+                line.sxy += add.sxy;
+                line.syy += add.syy;
+            }
+        }
+        freePlayer(player);
+    }
+
+    for (int depth = 2; depth <= PROBCUT_MAX_DEPTH; depth++)
+    {
+        fprintf(stderr, "depth %2d:", depth);
+        for (int shallow = 1; shallow < depth; shallow++)
+        {
+            double a, b, sigma;
+            solveLine(total[depth][shallow], &a, &b, &sigma);
+            fprintf(stderr, "  [%d] a %.3f b %+.2f sigma %.2f", shallow, a, b, sigma);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    printf("const ProbCutFit probcut_fit[PROBCUT_MAX_DEPTH + 1] = {\n");
+    for (int depth = 0; depth <= PROBCUT_MAX_DEPTH; depth++)
+    {
+        double a, b, sigma;
+        if (depth < PROBCUT_MIN_DEPTH || depth - FIT_PROBCUT_REDUCTION < 1)
+        {
+            printf("    {0, 0, 0, 0},\n");
+            continue;
+        }
+        solveLine(total[depth][depth - FIT_PROBCUT_REDUCTION], &a, &b, &sigma);
+        printf("    {%d, %.3f, %.1f, %.1f},\n", FIT_PROBCUT_REDUCTION, a, b, sigma);
+    }
+    printf("};\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--probcut") == 0)
+    {
+        return fitProbCut(argc - 2, argv + 2);
+    }
+    if (argc < 5)
+    {
+        fprintf(stderr, "usage: %s <eval_file> <games_per_map> <depth> <map_file>...\n", argv[0]);
+        return 1;
+    }
+    const char *eval_path = argv[1];
+    int games = atoi(argv[2]);
+    int depth = max(1, atoi(argv[3]));
+
+    vector<FitSample> samples;
+    for (int k = 4; k < argc; k++)
+    {
+        Player *player = readMap(argv[k]);
+        if (player == NULL)
+        {
+            fprintf(stderr, "cannot read %s\n", argv[k]);
+            return 1;
+        }
+        init_mat.clear();
+        general_score = 0;
+        init(player);
+        if (!bit_enabled)
+        {
+            fprintf(stderr, "%s: board too large for the bitboard, skipped\n", argv[k]);
+            freePlayer(player);
+            continue;
+        }
+        search_deadline = search_clock::time_point::max();
+        search_stop = false;
+        mt19937 rng((uint32_t)getMapKey(player));
+        BitBoard start = loadBits(player);
+        size_t before = samples.size();
+        for (int g = 0; g < games; g++)
+        {
+            playGame(start, depth, g % FIT_HOLDOUT == FIT_HOLDOUT - 1, rng, samples, NULL);
+        }
+        fprintf(stderr, "%s: strategy %d, %d games, %zu samples\n", argv[k], strategy, games, samples.size() - before);
+        freePlayer(player);
+    }
+
+    //终局分差对手写评估的最小二乘系数
+    double hh = 0, ht = 0;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        if (!samples[i].holdout)
+        {
+            hh += (double)samples[i].hand * samples[i].hand;
+            ht += (double)samples[i].hand * samples[i].target;
+            for (int f = 0; f < samples[i].cnt; f++)
+            {
+                fit_count[samples[i].feature[f]]++;
+            }
+        }
+    }
+    double a = hh > 0 ? ht / hh : 0;
+    if (a <= 0)
+    {
+        fprintf(stderr, "hand evaluation does not correlate with the final margin (a = %g)\n", a);
+        return 1;
+    }
+
+    vector<size_t> order;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        if (!samples[i].holdout)
+        {
+            order.push_back(i);
+        }
+    }
+    mt19937 shuffle_rng(20240716);
+    for (int epoch = 0; epoch < FIT_EPOCHS; epoch++)
+    {
+        shuffle(order.begin(), order.end(), shuffle_rng);
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            const FitSample &sample = samples[order[i]];
+            double err = sample.target - a * sample.hand - predictFitted(sample);
+            double norm = 0;
+            for (int f = 0; f < sample.cnt; f++)
+            {
+                norm += sample.weight[f] * sample.weight[f];
+            }
+            for (int f = 0; f < sample.cnt; f++)
+            {
+                double &value = fit_value[sample.feature[f]];
+                value += FIT_RATE * err * sample.weight[f] / max(1e-9, norm) - FIT_L2 * value;
+            }
+        }
+    }
+    fprintf(stderr, "a = %.4f  rmse train %.2f -> %.2f  holdout %.2f -> %.2f\n", a,
+            getRmse(samples, false, a, false), getRmse(samples, false, a, true),
+            getRmse(samples, true, a, false), getRmse(samples, true, a, true));
+
+    FILE *file = fopen(eval_path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "cannot write %s\n", eval_path);
+        return 1;
+    }
+    EvalHeader header = {{'C', 'K', 'E', 'V', 'A', 'L', 0, 0}, EVAL_VERSION, (uint32_t)fit_base.size()};
+    fwrite(&header, sizeof(header), 1, file);
+    for (map<pair<int, int>, int>::iterator it = fit_base.begin(); it != fit_base.end(); ++it)
+    {
+        EvalSection section = {(uint32_t)it->first.first, (uint32_t)it->first.second};
+        fwrite(&section, sizeof(section), 1, file);
+        vector<int32_t> values(pow3[section.len]);
+        for (int index = 0; index < pow3[section.len]; index++)
+        {
+            int f = it->second + index;
+            values[index] = fit_count[f] >= FIT_MIN_COUNT ? (int32_t)round(fit_value[f] / a * EVAL_FILE_SCALE) : 0;
+        }
+        fwrite(values.data(), sizeof(int32_t), values.size(), file);
+    }
+    fclose(file);
+    fprintf(stderr, "%zu sections written to %s\n", fit_base.size(), eval_path);
+    return 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file gen_map.c
+ * @brief 随机地图生成器：make gen_map && ./bin/gen_map --rows=16 --cols=20 [--values=权重] [--border=权重]
+ *        [--digits=比例] [--seed=种子] > map.txt
+ *
+ * 输出与 data/map*.txt 相同的格式：第一行行数和列数，之后每行一个字符串。
+ * 除中央四个初始棋子外，每个格子以 --digits 的概率是数字格子 '1'-'9'，否则是射线可以穿过的 '0'；
+ * 数字按 --values 给出的 9 个权重抽取（依次对应 1-9，默认均匀），最外一圈按 --border 抽取（默认与 --values 相同），
+ * 例如 --values=1,0,0,0,0,0,0,0,0 --border=0,0,0,0,0,0,0,1,1 得到与 data/map2.txt 类似的地图。
+ * 初始棋子与 data/map*.txt 相同：第 rows/2 - 1 行为 "oO"，第 rows/2 行为 "Oo"。
+ * 同样的参数和种子总是得到同样的地图。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <random>
+
+using namespace std;
+
+#define GEN_MIN_SIDE 4  // 最小边长，放得下中央四个棋子
+#define GEN_MAX_SIDE 64 // 最大边长，只用于检查参数，引擎支持的大小见 player.h
+
+/**
+ * 解析 --name=value 形式的参数
+ * @return true 参数名为 name
+ */
+bool parseFlag(const char *arg, const char *name, string *value)
+{
+    size_t len = strlen(name);
+    if (strncmp(arg, "--", 2) != 0 || strncmp(arg + 2, name, len) != 0 || arg[2 + len] != '=')
+    {
+        return false;
+    }
+    *value = arg + 3 + len;
+    return true;
+}
+
+/**
+ * 解析以逗号分隔的 9 个非负权重
+ * @param[in] text 参数值
+ * @param[out] weight 数字 1-9 的权重
+ * @return false 个数不是 9、有负数或者全为 0
+ */
+bool parseWeights(const string &text, vector<double> *weight)
+{
+    weight->clear();
+    const char *p = text.c_str();
+    while (*p != '\0')
+    {
+        char *end;
+        double w = strtod(p, &end);
+        if (end == p || w < 0)
+        {
+            return false;
+        }
+        weight->push_back(w);
+        p = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0')
+        {
+            return false;
+        }
+    }
+    double total = 0;
+    for (size_t k = 0; k < weight->size(); k++)
+    {
+        total += (*weight)[k];
+    }
+    return weight->size() == 9 && total > 0;
+}
+
+int main(int argc, char **argv)
+{
+    int rows = 0, cols = 0;
+    double digits = 1.0;
+    unsigned seed = 1;
+    vector<double> values(9, 1.0), border;
+    string value;
+    for (int k = 1; k < argc; k++)
+    {
+        if (parseFlag(argv[k], "rows", &value))
+        {
+            rows = atoi(value.c_str());
+        }
+        else if (parseFlag(argv[k], "cols", &value))
+        {
+            cols = atoi(value.c_str());
+        }
+        else if (parseFlag(argv[k], "digits", &value))
+        {
+            digits = atof(value.c_str());
+        }
+        else if (parseFlag(argv[k], "seed", &value))
+        {
+            seed = (unsigned)strtoul(value.c_str(), NULL, 10);
+        }
+        else if (parseFlag(argv[k], "values", &value))
+        {
+            if (!parseWeights(value, &values))
+            {
+                fprintf(stderr, "--values needs 9 non-negative weights for digits 1-9\n");
+                return 1;
+            }
+        }
+        else if (parseFlag(argv[k], "border", &value))
+        {
+            if (!parseWeights(value, &border))
+            {
+                fprintf(stderr, "--border needs 9 non-negative weights for digits 1-9\n");
+                return 1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "unknown argument %s\n", argv[k]);
+            return 1;
+        }
+    }
+    if (rows < GEN_MIN_SIDE || rows > GEN_MAX_SIDE || cols < GEN_MIN_SIDE || cols > GEN_MAX_SIDE ||
+        digits < 0 || digits > 1)
+    {
+        fprintf(stderr, "usage: %s --rows=<%d-%d> --cols=<%d-%d> [--values=w1,...,w9] [--border=w1,...,w9] "
+                        "[--digits=<0-1>] [--seed=<n>]\n",
+                argv[0], GEN_MIN_SIDE, GEN_MAX_SIDE, GEN_MIN_SIDE, GEN_MAX_SIDE);
+        return 1;
+    }
+    if (border.empty())
+    {
+        border = values;
+    }
+
+    mt19937 rng(seed);
+    bernoulli_distribution is_digit(digits);
+    discrete_distribution<int> inner_value(values.begin(), values.end());
+    discrete_distribution<int> border_value(border.begin(), border.end());
+    printf("%d %d\n", rows, cols);
+    for (int i = 0; i < rows; i++)
+    {
+        string line(cols, '0');
+        for (int j = 0; j < cols; j++)
+        {
+            //不管格子是不是数字都抽一次，改变 --digits 时其余格子的数字不变
+            bool edge = i == 0 || j == 0 || i == rows - 1 || j == cols - 1;
+            int digit = 1 + (edge ? border_value(rng) : inner_value(rng));
+            if (is_digit(rng))
+            {
+                line[j] = (char)('0' + digit);
+            }
+        }
+        if (i == rows / 2 - 1)
+        {
+            line[cols / 2 - 1] = 'o';
+            line[cols / 2] = 'O';
+        }
+        else if (i == rows / 2)
+        {
+            line[cols / 2 - 1] = 'O';
+            line[cols / 2] = 'o';
+        }
+        printf("%s\n", line.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,197 @@
+/**
+ * @file make_book.c
+ * @brief 离线生成开局库：make book && ./bin/book data/book.bin 3 500 data/map*.txt
+ *
+ * 对每张地图分别按原样和棋子颜色对调后生成，两种视角下又分别考虑我方先手和后手。
+ * 轮到我方时用 place 搜索 ms 毫秒，只沿最优落子往下走；轮到对方时展开所有合法落子，
+ * 直到我方下满 plies 步。结果按 (map_key, pos_key) 排序后写成 BookHeader + BookEntry 数组。
+ * 与前面的文件 getMapKey 相同的地图（例如内容相同的两个文件）跳过，不重复搜索和存储。
+ */
+
+#define FIXED_STRATEGY 0 // 同一地图每次运行得到相同的结果
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <set>
+
+#include "../code/player.h"
+
+/**
+ * 读取地图文件，格式与 data/map*.txt 相同：第一行行数和列数，之后每行一个字符串
+ * @param[in] path 地图文件路径
+ * @param[in] swap 是否对调 'O' 和 'o'
+ * @return 初始棋局，读取失败时返回 NULL
+ */
+Player *readMap(const char *path, bool swap)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    Player *player = new Player;
+    player->your_score = player->opponent_score = 0;
+    if (fscanf(file, "%d %d", &player->row_cnt, &player->col_cnt) != 2)
+    {
+        fclose(file);
+        delete player;
+        return NULL;
+    }
+    player->mat = new char *[player->row_cnt];
+    vector<char> line(player->col_cnt + 1);
+    for (int i = 0; i < player->row_cnt; i++)
+    {
+        player->mat[i] = new char[player->col_cnt];
+        if (fscanf(file, "%s", line.data()) != 1)
+        {
+            line.assign(player->col_cnt + 1, '0');
+        }
+        for (int j = 0; j < player->col_cnt; j++)
+        {
+            char c = line[j];
+            if (swap && (c == 'O' || c == 'o'))
+                c = c == 'O' ? 'o' : 'O';
+            player->mat[i][j] = c;
+        }
+    }
+    fclose(file);
+    return player;
+}
+
+/**
+ * 从当前局面展开开局库
+ * @param[in] player 当前棋局，返回时恢复原状
+ * @param[in] map_key 地图指纹
+ * @param[in] plies 我方还要下的步数
+ * @param[in] nowPlayer 当前是否轮到我方
+ * @param[in] seen 已经写入开局库的局面
+ * @param[out] entries 开局库表项
+ */
+void buildBook(Player *player, uint64_t map_key, int plies, bool nowPlayer, set<uint64_t> &seen, vector<BookEntry> &entries)
+{
+    if (plies == 0)
+    {
+        return;
+    }
+    vector<Point> points;
+    for (int i = 0; i < player->row_cnt; i++)
+    {
+        for (int j = 0; j < player->col_cnt; j++)
+        {
+            if (isValid(player, i, j, nowPlayer))
+            {
+                points.push_back(initPoint(i, j));
+            }
+        }
+    }
+    if (points.empty())
+    {
+        for (int i = 0; i < player->row_cnt; i++)
+        {
+            for (int j = 0; j < player->col_cnt; j++)
+            {
+                if (isValid(player, i, j, !nowPlayer))
+                {
+                    buildBook(player, map_key, plies, !nowPlayer, seen, entries);
+                    return;
+                }
+            }
+        }
+        return;
+    }
+
+    if (nowPlayer)
+    {
+        BitBoard board = loadBits(player);
+        if (!seen.insert(board.hash).second)
+        {
+            return;
+        }
+        Point point = place(player);
+        BookEntry entry = {map_key, board.hash, point.X * player->col_cnt + point.Y, depth_log[move_cnt - 1]};
+        entries.push_back(entry);
+        doStep(player, point.X, point.Y, true);
+        buildBook(player, map_key, plies - 1, false, seen, entries);
+        undoStep(player);
+    }
+    else
+    {
+        for (size_t k = 0; k < points.size(); k++)
+        {
+            doStep(player, points[k].X, points[k].Y, false);
+            buildBook(player, map_key, plies, true, seen, entries);
+            undoStep(player);
+        }
+    }
+}
+
+bool compareEntry(const BookEntry &a, const BookEntry &b)
+{
+    return a.map_key != b.map_key ? a.map_key < b.map_key : a.pos_key < b.pos_key;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 5)
+    {
+        fprintf(stderr, "usage: %s <book_file> <plies> <ms_per_move> <map_file>...\n", argv[0]);
+        return 1;
+    }
+    const char *book_file = argv[1];
+    int plies = atoi(argv[2]);
+    int ms = atoi(argv[3]);
+
+    vector<BookEntry> entries;
+    set<uint64_t> map_keys; // 已经生成过的地图
+    for (int k = 4; k < argc; k++)
+    {
+        for (int swap = 0; swap < 2; swap++)
+        {
+            Player *player = readMap(argv[k], swap);
+            if (player == NULL)
+            {
+                fprintf(stderr, "cannot read %s\n", argv[k]);
+                return 1;
+            }
+            init_mat.clear();
+            general_score = 0;
+            init(player);
+            if (!bit_enabled)
+            {
+                fprintf(stderr, "%s: board too large for the bitboard, skipped\n", argv[k]);
+                freePlayer(player);
+                break;
+            }
+            if (!map_keys.insert(book_map_key).second)
+            {
+                fprintf(stderr, "%s%s: same map as an earlier file, skipped\n", argv[k], swap ? " (swapped)" : "");
+                freePlayer(player);
+                continue;
+            }
+            book_active = false;
+            ponder_enabled = false;
+            time_limit_ms = ms;
+
+            set<uint64_t> seen;
+            size_t before = entries.size();
+            buildBook(player, book_map_key, plies, true, seen, entries);
+            buildBook(player, book_map_key, plies, false, seen, entries);
+            fprintf(stderr, "%s%s: %zu positions\n", argv[k], swap ? " (swapped)" : "", entries.size() - before);
+            freePlayer(player);
+        }
+    }
+
+    sort(entries.begin(), entries.end(), compareEntry);
+    BookHeader header = {{'C', 'K', 'B', 'O', 'O', 'K', 0, 0}, BOOK_VERSION, (uint32_t)entries.size()};
+    FILE *file = fopen(book_file, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "cannot write %s\n", book_file);
+        return 1;
+    }
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(entries.data(), sizeof(BookEntry), entries.size(), file);
+    fclose(file);
+    fprintf(stderr, "%zu entries written to %s\n", entries.size(), book_file);
+    return 0;
+}
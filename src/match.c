@@ -0,0 +1,360 @@
+/**
+ * @file match.c
+ * @brief 进程内对局程序：make match && ./bin/match [-g 局数] [-j 并行数] [-l elo0] [-u elo1] data/map*.txt
+ *
+ * 引擎 A 和引擎 B 由 make match 的 ENGINE_A、ENGINE_B、FLAGS_A、FLAGS_B 指定，
+ * 默认是 code/player.h 对 code/computer.h。每张地图连续下两局并交换先后手，
+ * 每局在单独 fork 出的子进程中进行，引擎的全局状态不会带到下一局。
+ * 裁判规则与评测程序一致：落子得到格子分数，翻转得到被翻转格子的分数，
+ * 一方无子可下时由另一方继续，双方都不能下时终局，下出非法落子的一方判负。
+ * 输出 A 的胜负和、平均分差、Elo 及 95% 置信区间，并对 [elo0, elo1] 做 SPRT，
+ * 检验有结论时停止。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+
+#include "match.h"
+#include "referee.h"
+
+using namespace std;
+
+/**
+ * 子进程通过管道发回的一局结果，小于 PIPE_BUF，多个子进程同时写入不会交错
+ */
+struct GameResult
+{
+    int game;        // 局号
+    int a_score;     // 引擎 A 的得分
+    int b_score;     // 引擎 B 的得分
+    int forfeit;     // 0 正常终局，1 引擎 A 非法落子，2 引擎 B 非法落子
+    int moves;       // 双方落子总数
+    int max_move_ms; // 单步最长用时（毫秒）
+};
+
+/**
+ * 把棋盘按 me 的视角写入 player：me 的棋子为 'O'，对方为 'o'
+ */
+void loadView(const vector<string> &mat, char me, int your_score, int opponent_score, Player *player)
+{
+    for (int i = 0; i < player->row_cnt; i++)
+    {
+        for (int j = 0; j < player->col_cnt; j++)
+        {
+            char c = mat[i][j];
+            if (me == 'o' && (c == 'O' || c == 'o'))
+                c = c == 'O' ? 'o' : 'O';
+            player->mat[i][j] = c;
+        }
+    }
+    player->your_score = your_score;
+    player->opponent_score = opponent_score;
+}
+
+/**
+ * 下一局，在子进程中调用
+ * @param[in] map 地图
+ * @param[in] game 局号，偶数局引擎 A 先手
+ * @return 对局结果
+ */
+GameResult playGame(const MatchMap &map, int game)
+{
+    Engine *engine[2];
+    bool a_red = game % 2 == 0;
+    engine[0] = a_red ? &engine_a_entry : &engine_b_entry; //红方先手，棋子为 'O'
+    engine[1] = a_red ? &engine_b_entry : &engine_a_entry;
+    const char piece[2] = {'O', 'o'};
+
+    vector<string> mat = map.mat;
+    int score[2] = {0, 0};
+    Player player[2];
+    for (int side = 0; side < 2; side++)
+    {
+        player[side].row_cnt = map.row_cnt;
+        player[side].col_cnt = map.col_cnt;
+        player[side].mat = new char *[map.row_cnt];
+        for (int i = 0; i < map.row_cnt; i++)
+        {
+            player[side].mat[i] = new char[map.col_cnt];
+        }
+    }
+
+    GameResult result = {game, 0, 0, 0, 0, 0};
+    //两个引擎先后 init，各自使用自己视角的初始棋盘
+    for (int side = 0; side < 2; side++)
+    {
+        loadView(mat, piece[side], 0, 0, &player[side]);
+        engine[side]->init(&player[side]);
+    }
+
+    int side = 0;
+    while (true)
+    {
+        if (!refereeCanMove(map, mat, piece[side]))
+        {
+            if (!refereeCanMove(map, mat, piece[!side]))
+            {
+                break;
+            }
+            side = !side;
+        }
+        loadView(mat, piece[side], score[side], score[!side], &player[side]);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        Point point = engine[side]->place(&player[side]);
+        int ms = (int)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+        result.max_move_ms = max(result.max_move_ms, ms);
+        if (!refereeValid(map, mat, point.X, point.Y, piece[side]))
+        {
+            result.forfeit = (side == 0) == a_red ? 1 : 2;
+            break;
+        }
+        int flipped;
+        score[side] += refereeStep(map, mat, point.X, point.Y, piece[side], &flipped);
+        score[!side] -= flipped;
+        result.moves++;
+        side = !side;
+    }
+
+    result.a_score = a_red ? score[0] : score[1];
+    result.b_score = a_red ? score[1] : score[0];
+    return result;
+}
+
+/**
+ * 对局统计，全部从引擎 A 的角度
+ */
+struct MatchStats
+{
+    int wins;
+    int draws;
+    int losses;
+    long long margin;   // 分差之和
+    int forfeits[2];    // 引擎 A、B 非法落子的局数
+    int max_move_ms;    // 单步最长用时
+};
+
+/**
+ * 胜率对应的 Elo 差
+ */
+double scoreToElo(double score)
+{
+    score = min(max(score, 1e-6), 1 - 1e-6);
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+/**
+ * Elo 差对应的期望胜率
+ */
+double eloToScore(double elo)
+{
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+/**
+ * 每局得分的均值和方差，胜、和、负各加上 prior 局，避免全胜或全负时方差为 0
+ * @param[in] stats 当前统计
+ * @param[in] prior 每种结果额外加上的局数
+ * @param[out] score 每局得分的均值
+ * @param[out] var 每局得分的方差
+ */
+void getScoreVar(const MatchStats &stats, double prior, double *score, double *var)
+{
+    double w = stats.wins + prior, d = stats.draws + prior, l = stats.losses + prior;
+    double n = w + d + l;
+    *score = (w + 0.5 * d) / n;
+    *var = (w * (1 - *score) * (1 - *score) + d * (0.5 - *score) * (0.5 - *score) + l * *score * *score) / n;
+}
+
+/**
+ * 按三项分布（胜、和、负）的正态近似计算 H1: elo1 对 H0: elo0 的对数似然比
+ * @param[in] stats 当前统计
+ * @param[in] elo0 H0 的 Elo 差
+ * @param[in] elo1 H1 的 Elo 差
+ */
+double sprtLLR(const MatchStats &stats, double elo0, double elo1)
+{
+    int n = stats.wins + stats.draws + stats.losses;
+    if (n == 0)
+    {
+        return 0;
+    }
+    double score, var;
+    getScoreVar(stats, 0.5, &score, &var);
+    double s0 = eloToScore(elo0);
+    double s1 = eloToScore(elo1);
+    return (s1 - s0) * (2 * score - s0 - s1) * n / (2 * var);
+}
+
+/**
+ * 输出统计：done 为 false 时向 stderr 输出一行进度，为 true 时向 stdout 输出完整的结论
+ */
+void printStats(const MatchStats &stats, double elo0, double elo1, double alpha, double beta, bool done)
+{
+    int n = stats.wins + stats.draws + stats.losses;
+    if (n == 0)
+    {
+        return;
+    }
+    double score, var;
+    getScoreVar(stats, 0, &score, &var);
+    double err = 1.96 * sqrt(var / n);
+    double elo = scoreToElo(score);
+    double llr = sprtLLR(stats, elo0, elo1);
+    double lower = log(beta / (1 - alpha));
+    double upper = log((1 - beta) / alpha);
+
+    if (!done)
+    {
+        fprintf(stderr, "games %d  W/D/L %d/%d/%d  margin %+.2f  elo %+.1f [%+.1f, %+.1f]  LLR %.2f [%.2f, %.2f]\n",
+                n, stats.wins, stats.draws, stats.losses, (double)stats.margin / n, elo,
+                scoreToElo(score - err), scoreToElo(score + err), llr, lower, upper);
+        return;
+    }
+    const char *verdict = llr >= upper ? "H1 accepted" : llr <= lower ? "H0 accepted" : "inconclusive";
+    printf("A: %s\nB: %s\n", engine_a_entry.name, engine_b_entry.name);
+    printf("games %d  W/D/L %d/%d/%d  forfeits A %d B %d  max move %d ms\n", n, stats.wins, stats.draws,
+           stats.losses, stats.forfeits[0], stats.forfeits[1], stats.max_move_ms);
+    printf("score %.4f  margin %+.2f  elo %+.1f [%+.1f, %+.1f]\n", score, (double)stats.margin / n, elo,
+           scoreToElo(score - err), scoreToElo(score + err));
+    printf("SPRT elo0 %.1f elo1 %.1f alpha %.3f beta %.3f  LLR %.2f [%.2f, %.2f]  %s\n", elo0, elo1, alpha, beta,
+           llr, lower, upper, verdict);
+}
+
+Point initPoint(int x, int y)
+{
+    Point point;
+    point.X = x;
+    point.Y = y;
+    return point;
+}
+
+int main(int argc, char **argv)
+{
+    int games = 1000;
+    int jobs = max(1u, thread::hardware_concurrency());
+    double elo0 = 0, elo1 = 10, alpha = 0.05, beta = 0.05;
+    int opt;
+    while ((opt = getopt(argc, argv, "g:j:l:u:a:b:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'g':
+            games = atoi(optarg);
+            break;
+        case 'j':
+            jobs = max(1, atoi(optarg));
+            break;
+        case 'l':
+            elo0 = atof(optarg);
+            break;
+        case 'u':
+            elo1 = atof(optarg);
+            break;
+        case 'a':
+            alpha = atof(optarg);
+            break;
+        case 'b':
+            beta = atof(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-g games] [-j jobs] [-l elo0] [-u elo1] [-a alpha] [-b beta] <map_file>...\n", argv[0]);
+            return 1;
+        }
+    }
+    vector<MatchMap> maps;
+    for (int k = optind; k < argc; k++)
+    {
+        MatchMap map;
+        if (!readMatchMap(argv[k], &map))
+        {
+            fprintf(stderr, "cannot read %s\n", argv[k]);
+            return 1;
+        }
+        maps.push_back(map);
+    }
+    if (maps.empty())
+    {
+        fprintf(stderr, "no map file given\n");
+        return 1;
+    }
+
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        perror("pipe");
+        return 1;
+    }
+    fflush(stdout);
+    fflush(stderr);
+
+    //每张地图连续两局交换先后手，最多同时运行 jobs 个子进程
+    MatchStats stats = {};
+    double lower = log(beta / (1 - alpha));
+    double upper = log((1 - beta) / alpha);
+    int started = 0, running = 0;
+    bool stop = false;
+    while (running > 0 || (!stop && started < games))
+    {
+        while (!stop && started < games && running < jobs)
+        {
+            const MatchMap &map = maps[(started / 2) % maps.size()];
+            pid_t pid = fork();
+            if (pid < 0)
+            {
+                perror("fork");
+                return 1;
+            }
+            if (pid == 0)
+            {
+                close(fds[0]);
+                GameResult result = playGame(map, started);
+                ssize_t written = write(fds[1], &result, sizeof(result));
+                _exit(written == (ssize_t)sizeof(result) ? 0 : 1);
+            }
+            started++;
+            running++;
+        }
+
+        GameResult result;
+        if (read(fds[0], &result, sizeof(result)) != (ssize_t)sizeof(result))
+        {
+            fprintf(stderr, "lost a game result\n");
+            return 1;
+        }
+        wait(NULL);
+        running--;
+
+        int margin = result.a_score - result.b_score;
+        if (result.forfeit == 1 || (result.forfeit == 0 && margin < 0))
+            stats.losses++;
+        else if (result.forfeit == 2 || margin > 0)
+            stats.wins++;
+        else
+            stats.draws++;
+        if (result.forfeit > 0)
+            stats.forfeits[result.forfeit - 1]++;
+        stats.margin += margin;
+        stats.max_move_ms = max(stats.max_move_ms, result.max_move_ms);
+
+        int n = stats.wins + stats.draws + stats.losses;
+        double llr = sprtLLR(stats, elo0, elo1);
+        if (llr >= upper || llr <= lower)
+        {
+            stop = true;
+        }
+        if (n % 20 == 0)
+        {
+            printStats(stats, elo0, elo1, alpha, beta, false);
+        }
+    }
+    printStats(stats, elo0, elo1, alpha, beta, true);
+    return 0;
+}
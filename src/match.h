@@ -0,0 +1,24 @@
+/**
+ * @file match.h
+ * @brief 对局程序和引擎之间的接口，见 match.c 和 match_engine.c
+ */
+
+#ifndef SRC_MATCH_H_
+#define SRC_MATCH_H_
+
+#include "../include/playerbase.h"
+
+/**
+ * 一个引擎的入口，init 和 place 与评测程序调用的接口相同
+ */
+struct Engine
+{
+    const char *name;              // 引擎头文件和编译选项
+    void (*init)(Player *player);  // 每局开始时调用一次
+    Point (*place)(Player *player); // 返回落子位置，无子可下时不会被调用
+};
+
+extern Engine engine_a_entry; // 被测引擎
+extern Engine engine_b_entry; // 对照引擎
+
+#endif // SRC_MATCH_H_
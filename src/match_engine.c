@@ -0,0 +1,51 @@
+/**
+ * @file match_engine.c
+ * @brief 对局程序的一个引擎：make match 把它编译两次，分别包含 ENGINE_A 和 ENGINE_B
+ *
+ * 引擎头文件放进命名空间 ENGINE_NS，两个引擎的全局变量和函数互不冲突，
+ * 每个引擎单独编译，所以可以用不同的宏（例如 -DTIME_LIMIT_MS=20）配置。
+ * 引擎头文件用到的系统头文件必须先在命名空间外包含。
+ */
+
+#include <iostream>
+#include <vector>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
+#include <cassert>
+#include <atomic>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <pthread.h>
+#endif
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdbool.h>
+#if USE_PROFILE
+#include <mutex>
+#endif
+#if (USE_PROFILE || USE_NNUE) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+#include "match.h"
+
+namespace ENGINE_NS
+{
+#include ENGINE_HEADER
+}
+
+#define ENGINE_CAT(a, b) a##b
+#define ENGINE_ENTRY(ns) ENGINE_CAT(ns, _entry)
+
+Engine ENGINE_ENTRY(ENGINE_NS) = {ENGINE_NAME, ENGINE_NS::init, ENGINE_NS::place};
@@ -0,0 +1,172 @@
+/**
+ * @file referee.h
+ * @brief 裁判规则：地图读取、落子合法性、翻转和计分，由 match.c 和 fast_judge.c 共用
+ *
+ * 规则与评测程序一致：落子得到格子分数，翻转得到被翻转格子的分数，对方失去被翻转的部分。
+ */
+
+#ifndef SRC_REFEREE_H_
+#define SRC_REFEREE_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+
+using namespace std;
+
+/**
+ * 一张地图，mat 中 'O' 为先手（红方），'o' 为后手（蓝方）
+ */
+struct MatchMap
+{
+    string path;
+    int row_cnt;
+    int col_cnt;
+    vector<string> mat;
+};
+
+/**
+ * 读取地图文件，格式与 data/map*.txt 相同：第一行行数和列数，之后每行一个字符串
+ * @param[in] path 地图文件路径
+ * @param[out] map 地图
+ * @return true 读取成功
+ */
+bool readMatchMap(const char *path, MatchMap *map)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return false;
+    }
+    map->path = path;
+    if (fscanf(file, "%d %d", &map->row_cnt, &map->col_cnt) != 2 || map->row_cnt <= 0 || map->col_cnt <= 0)
+    {
+        fclose(file);
+        return false;
+    }
+    vector<char> line(map->col_cnt + 1);
+    map->mat.assign(map->row_cnt, string());
+    for (int i = 0; i < map->row_cnt; i++)
+    {
+        if (fscanf(file, "%s", line.data()) != 1 || (int)strlen(line.data()) != map->col_cnt)
+        {
+            fclose(file);
+            return false;
+        }
+        map->mat[i] = line.data();
+    }
+    fclose(file);
+    return true;
+}
+
+/**
+ * 与 player.h 的 isValid 相同的判断，me 为下棋方的棋子
+ * @param[in] map 地图
+ * @param[in] mat 当前棋盘
+ * @param[in] x 落子横坐标
+ * @param[in] y 落子纵坐标
+ * @param[in] me 'O' 或 'o'
+ */
+bool refereeValid(const MatchMap &map, const vector<string> &mat, int x, int y, char me)
+{
+    if (x < 0 || x >= map.row_cnt || y < 0 || y >= map.col_cnt || mat[x][y] == 'o' || mat[x][y] == 'O')
+    {
+        return false;
+    }
+    char op = me == 'O' ? 'o' : 'O';
+    static const int step[8][2] = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}, {1, 1}, {-1, -1}, {1, -1}, {-1, 1}};
+    for (int i = 0; i < 8; i++)
+    {
+        int cx = x + step[i][0];
+        int cy = y + step[i][1];
+        if (cx < 0 || cx >= map.row_cnt || cy < 0 || cy >= map.col_cnt || mat[cx][cy] != op)
+        {
+            continue;
+        }
+        while (true)
+        {
+            cx += step[i][0];
+            cy += step[i][1];
+            if (cx < 0 || cx >= map.row_cnt || cy < 0 || cy >= map.col_cnt || (mat[cx][cy] >= '1' && mat[cx][cy] <= '9'))
+            {
+                break;
+            }
+            if (mat[cx][cy] == me)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * 下棋方 me 是否有合法落子
+ */
+bool refereeCanMove(const MatchMap &map, const vector<string> &mat, char me)
+{
+    for (int i = 0; i < map.row_cnt; i++)
+    {
+        for (int j = 0; j < map.col_cnt; j++)
+        {
+            if (refereeValid(map, mat, i, j, me))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * 初始地图上格子的分数，与 player.h 的 getScoreOfPoint 相同
+ */
+int refereeCellScore(const MatchMap &map, int x, int y)
+{
+    char c = map.mat[x][y];
+    return c == 'o' || c == 'O' ? 0 : c - '0';
+}
+
+/**
+ * 与 player.h 的 doStep 相同的落子和翻转，返回下棋方得到的分数，对方失去其中被翻转的部分
+ * @param[in] map 地图
+ * @param[in] mat 当前棋盘
+ * @param[in] x 落子横坐标
+ * @param[in] y 落子纵坐标
+ * @param[in] me 'O' 或 'o'
+ * @param[out] flipped 被翻转棋子的分数
+ */
+int refereeStep(const MatchMap &map, vector<string> &mat, int x, int y, char me, int *flipped)
+{
+    char op = me == 'O' ? 'o' : 'O';
+    static const int step[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+    mat[x][y] = me;
+    *flipped = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        int cx = x + step[i][0];
+        int cy = y + step[i][1];
+        int cnt = 0;
+        while (cx >= 0 && cx < map.row_cnt && cy >= 0 && cy < map.col_cnt && mat[cx][cy] == op)
+        {
+            cx += step[i][0];
+            cy += step[i][1];
+            cnt++;
+        }
+        if (cnt == 0 || cx < 0 || cx >= map.row_cnt || cy < 0 || cy >= map.col_cnt || mat[cx][cy] != me)
+        {
+            continue;
+        }
+        for (int k = 1; k <= cnt; k++)
+        {
+            int fx = x + k * step[i][0];
+            int fy = y + k * step[i][1];
+            mat[fx][fy] = me;
+            *flipped += refereeCellScore(map, fx, fy);
+        }
+    }
+    return *flipped + refereeCellScore(map, x, y);
+}
+
+#endif // SRC_REFEREE_H_
@@ -0,0 +1,169 @@
+/**
+ * @file scale.c
+ * @brief 按棋盘大小比较搜索能力：make scale，或 ./bin/scale 地图文件...
+ *
+ * 对每张地图按固定的伪随机序列下到棋盘格子数的 scale_stages 百分比，每个步数取 SCALE_POSITIONS 个局面，
+ * 在每个局面上调用与对局相同的 place（同样的时间限制和位棋盘、一维棋盘、char 矩阵的选择），
+ * 每个局面输出一行 JSON：使用的搜索、完成的深度、结点数、用时和每秒结点数，
+ * 每张地图最后输出一行 summary，给出平均深度和总的每秒结点数，便于看出面积增大时搜索在哪里跟不上。
+ * make scale 先用 gen_map 生成 8x8 到 24x24 以及长方形的地图，单线程、不后台搜索编译后运行。
+ */
+
+#define FIXED_STRATEGY 0 // 同一地图每次运行得到相同的结果
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../code/player.h"
+
+#define SCALE_POSITIONS 3 // 每个步数取的局面数
+
+const int scale_stages[] = {10, 30, 50}; // 取局面时已经下满的格子数百分比
+
+/**
+ * 读取地图文件，格式与 data/map*.txt 相同：第一行行数和列数，之后每行一个字符串
+ * @param[in] path 地图文件路径
+ * @return 初始棋局，读取失败时返回 NULL
+ */
+Player *readScaleMap(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    Player *player = new Player;
+    player->your_score = player->opponent_score = 0;
+    if (fscanf(file, "%d %d", &player->row_cnt, &player->col_cnt) != 2)
+    {
+        fclose(file);
+        delete player;
+        return NULL;
+    }
+    player->mat = new char *[player->row_cnt];
+    vector<char> line(player->col_cnt + 1);
+    for (int i = 0; i < player->row_cnt; i++)
+    {
+        player->mat[i] = new char[player->col_cnt];
+        if (fscanf(file, "%s", line.data()) != 1)
+        {
+            line.assign(player->col_cnt + 1, '0');
+        }
+        memcpy(player->mat[i], line.data(), player->col_cnt);
+    }
+    fclose(file);
+    return player;
+}
+
+/**
+ * 用 isValid 按行优先顺序列出所有合法落子点
+ * @return 落子点个数
+ */
+int listMoves(Player *player, bool nowPlayer, Point *points)
+{
+    int cnt = 0;
+    for (int i = 0; i < player->row_cnt; i++)
+    {
+        for (int j = 0; j < player->col_cnt; j++)
+        {
+            if (isValid(player, i, j, nowPlayer))
+            {
+                points[cnt++] = initPoint(i, j);
+            }
+        }
+    }
+    return cnt;
+}
+
+/**
+ * 从初始局面按线性同余序列随机下 plies 步，一方无子可下时由另一方继续，最后再让对方多下一步使轮到我方
+ * @param[in] player 初始棋局，原地修改，用 undoStep 恢复
+ * @param[in] plies 至少要下的步数
+ * @param[in] seed 序列的种子
+ * @return true 下完后轮到我方且有子可下
+ */
+bool playRandom(Player *player, int plies, uint32_t seed)
+{
+    vector<Point> points(player->row_cnt * player->col_cnt);
+    bool side = true;
+    for (int ply = 0; ply < plies || side != true; ply++)
+    {
+        int cnt = listMoves(player, side, points.data());
+        if (cnt == 0)
+        {
+            side = !side;
+            cnt = listMoves(player, side, points.data());
+            if (cnt == 0)
+            {
+                return false;
+            }
+        }
+        seed = seed * 1103515245u + 12345u;
+        Point point = points[(seed >> 16) % cnt];
+        doStep(player, point.X, point.Y, side);
+        side = !side;
+    }
+    return listMoves(player, true, points.data()) > 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <map_file>...\n", argv[0]);
+        return 1;
+    }
+    for (int k = 1; k < argc; k++)
+    {
+        Player *player = readScaleMap(argv[k]);
+        if (player == NULL)
+        {
+            fprintf(stderr, "cannot read %s\n", argv[k]);
+            return 1;
+        }
+        init_mat.clear();
+        general_score = 0;
+        init(player);
+        int area = player->row_cnt * player->col_cnt;
+        uint32_t seed = (uint32_t)getMapKey(player);
+
+        int positions = 0;
+        long long depth_sum = 0, nodes_sum = 0, us_sum = 0;
+        for (size_t s = 0; s < sizeof(scale_stages) / sizeof(scale_stages[0]); s++)
+        {
+            for (int r = 0; r < SCALE_POSITIONS; r++)
+            {
+                step_top = flip_top = 0;
+                int plies = area * scale_stages[s] / 100;
+                if (playRandom(player, plies, seed + (uint32_t)(s * SCALE_POSITIONS + r)))
+                {
+                    //局面之间没有关系，不让上一个局面的整局用时影响时间分配
+                    game_time_used = 0;
+                    search_clock::time_point start = search_clock::now();
+                    Point point = place(player);
+                    long long us = chrono::duration_cast<chrono::microseconds>(search_clock::now() - start).count();
+                    long long nodes = search_nodes + helper_nodes;
+                    printf("{\"map\":\"%s\",\"rows\":%d,\"cols\":%d,\"area\":%d,\"strategy\":%d,\"stage\":%d,\"source\":\"%s\","
+                           "\"depth\":%d,\"nodes\":%lld,\"ms\":%.3f,\"nps\":%.0f,\"x\":%d,\"y\":%d}\n",
+                           argv[k], player->row_cnt, player->col_cnt, area, strategy, scale_stages[s], search_report.source,
+                           search_report.depth, nodes, us / 1e3, nodes * 1e6 / max(1LL, us), point.X, point.Y);
+                    positions++;
+                    depth_sum += search_report.depth;
+                    nodes_sum += nodes;
+                    us_sum += us;
+                }
+                while (step_top > 0)
+                {
+                    undoStep(player);
+                }
+            }
+        }
+        printf("{\"map\":\"%s\",\"rows\":%d,\"cols\":%d,\"area\":%d,\"strategy\":%d,\"test\":\"summary\",\"positions\":%d,"
+               "\"depth\":%.2f,\"nps\":%.0f}\n",
+               argv[k], player->row_cnt, player->col_cnt, area, strategy, positions,
+               (double)depth_sum / max(1, positions), nodes_sum * 1e6 / max(1LL, us_sum));
+        fflush(stdout);
+        freePlayer(player);
+    }
+    return 0;
+}
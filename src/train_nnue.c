@@ -0,0 +1,537 @@
+/**
+ * @file train_nnue.c
+ * @brief 训练神经网络评估：make train_nnue && ./bin/train_nnue data/nnue.bin 200 3 data/map*.txt
+ *
+ * 与 fit_eval.c 相同地自我对局：双方都用 pvsBits 搜索固定深度 depth（手写评估），
+ * 前 TRAIN_RANDOM_PLIES 步和之后 TRAIN_EPSILON 的概率随机落子，每局记下棋谱（落子序列）和终局分差。
+ * 训练时重放棋谱，每个局面用 player.h 的 getNnueFeatures 取特征，双方对调后再取一次，
+ * 目标是终局分差除以训练集分差的均方根；网络用浮点数和随机梯度下降训练，
+ * 两个隐层的激活与整数推理相同地截断在 [0, 1]。
+ * 训练完按 NNUE_QA 和 NNUE_QB_SHIFT 量化写成 NnueHeader 加上各层权重，
+ * 输出换算成手写评估的单位：除以终局分差对手写评估的最小二乘系数 a（与 fit_eval.c 相同）。
+ * 每 TRAIN_HOLDOUT 局留出一局不参与训练，最后载入写出的文件重放留出的棋谱，
+ * 比较 a 乘手写评估、浮点网络和整数网络对终局分差的误差，并检查增量累加器与从头计算一致。
+ */
+
+#define EVAL_FILE "" // 自我对局和比较的基准都只用手写评估
+#define USE_NNUE 1
+#define NNUE_FILE "" // 训练前不读已有的权重
+#define FIXED_STRATEGY 0 // 同样的参数总是得到同样的对局
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../code/player.h"
+
+#define TRAIN_RANDOM_PLIES 8 // 开局随机落子的步数
+#define TRAIN_EPSILON 0.1    // 之后随机落子的概率
+#define TRAIN_EPOCHS 5       // 随机梯度下降的轮数
+#define TRAIN_RATE 0.01      // 第二层和输出层的学习率，每轮乘以 TRAIN_DECAY
+#define TRAIN_DECAY 0.7      // 学习率每轮的衰减
+#define TRAIN_HOLDOUT 10     // 每 10 局留出 1 局做验证
+
+/**
+ * 一局自我对局的棋谱
+ */
+struct GameRecord
+{
+    int map;           // 地图在命令行中的序号
+    vector<int> moves; // 依次的落子位置，-1 表示无子可下
+    int margin;        // 终局分差，我方减对方
+    bool holdout;      // 是否留作验证
+};
+
+/**
+ * 一个训练样本，特征下标存放在 train_features[begin, begin + cnt)
+ */
+struct TrainSample
+{
+    size_t begin;  // 特征的起始位置
+    int cnt;       // 特征个数，即格子数
+    float hand;    // 手写评估值
+    float target;  // 终局分差
+    bool holdout;  // 是否留作验证
+};
+
+vector<uint16_t> train_features; // 所有样本的特征下标
+
+//浮点网络，结构与 player.h 中的整数网络相同，net_wp 是直接加到输出的线性部分
+float net_w1[NNUE_FEATURES][NNUE_HIDDEN];
+float net_b1[NNUE_HIDDEN];
+float net_w2[NNUE_HIDDEN2][NNUE_HIDDEN];
+float net_b2[NNUE_HIDDEN2];
+float net_w3[NNUE_HIDDEN2];
+float net_b3;
+float net_wp[NNUE_FEATURES];
+
+/**
+ * 读取地图文件，格式与 data/map*.txt 相同：第一行行数和列数，之后每行一个字符串
+ * @param[in] path 地图文件路径
+ * @return 初始棋局，读取失败时返回 NULL
+ */
+Player *readTrainMap(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    Player *player = new Player;
+    player->your_score = player->opponent_score = 0;
+    if (fscanf(file, "%d %d", &player->row_cnt, &player->col_cnt) != 2)
+    {
+        fclose(file);
+        delete player;
+        return NULL;
+    }
+    player->mat = new char *[player->row_cnt];
+    vector<char> line(player->col_cnt + 1);
+    for (int i = 0; i < player->row_cnt; i++)
+    {
+        player->mat[i] = new char[player->col_cnt];
+        if (fscanf(file, "%s", line.data()) != 1)
+        {
+            line.assign(player->col_cnt + 1, '0');
+        }
+        memcpy(player->mat[i], line.data(), player->col_cnt);
+    }
+    fclose(file);
+    return player;
+}
+
+/**
+ * 按地图初始化引擎的全局状态，之后 loadBits 得到初始局面
+ * @return false 地图放不进位棋盘
+ */
+bool startMap(Player *player)
+{
+    init_mat.clear();
+    general_score = 0;
+    init(player);
+    search_deadline = search_clock::time_point::max();
+    search_stop = false;
+    return bit_enabled;
+}
+
+/**
+ * 固定深度搜索一方的最优落子，与 fit_eval.c 的 searchMove 相同
+ */
+int searchMove(BitBoard &board, Bits moves, int depth, bool nowPlayer)
+{
+    int list[BB_MAX_CELLS];
+    int order[BB_MAX_CELLS];
+    int cnt = orderMoves(moves, -1, 0, nowPlayer, list, order);
+    int best = -1;
+    int alpha = -SEARCH_INF;
+    for (int i = 0; i < cnt; i++)
+    {
+        int pos = pickMove(list, order, cnt, i);
+        doStepBits(&board, pos, nowPlayer);
+        int score = -pvsBits(board, depth - 1, -SEARCH_INF, -alpha, !nowPlayer);
+        undoStepBits(&board);
+        if (best < 0 || score > alpha)
+        {
+            alpha = score;
+            best = pos;
+        }
+    }
+    return best;
+}
+
+/**
+ * 自我对局一局，返回棋谱
+ */
+GameRecord playGame(const BitBoard &start, int map, int depth, bool holdout, mt19937 &rng)
+{
+    GameRecord record;
+    record.map = map;
+    record.holdout = holdout;
+    BitBoard board = start;
+    uniform_real_distribution<double> coin(0, 1);
+    bool nowPlayer = true;
+    int passes = 0;
+    for (int ply = 0; passes < 2; ply++)
+    {
+        Bits moves = nowPlayer ? getValidMask(board.own, board.opp) : getValidMask(board.opp, board.own);
+        int cnt = bitCount(moves);
+        if (cnt == 0)
+        {
+            passes++;
+            record.moves.push_back(-1);
+            nowPlayer = !nowPlayer;
+            continue;
+        }
+        passes = 0;
+        int pos;
+        if (ply < TRAIN_RANDOM_PLIES || coin(rng) < TRAIN_EPSILON)
+        {
+            for (int k = (int)(rng() % cnt); k > 0; k--)
+            {
+                bitPop(moves);
+            }
+            pos = bitPop(moves);
+        }
+        else
+        {
+            pos = searchMove(board, moves, depth, nowPlayer);
+        }
+        doStepBits(&board, pos, nowPlayer);
+        bit_undo_top = 0;
+        record.moves.push_back(pos);
+        nowPlayer = !nowPlayer;
+    }
+    record.margin = board.your_score - board.opponent_score;
+    return record;
+}
+
+/**
+ * 重放棋谱，每个有子可下的局面从我方和对方各取一个样本
+ */
+void addSamples(const BitBoard &start, const GameRecord &record, vector<TrainSample> &samples)
+{
+    BitBoard board = start;
+    bool nowPlayer = true;
+    int features[BB_MAX_CELLS];
+    for (size_t i = 0; i < record.moves.size(); i++)
+    {
+        int pos = record.moves[i];
+        if (pos >= 0)
+        {
+            for (int swap = 0; swap < 2; swap++)
+            {
+                TrainSample sample;
+                sample.begin = train_features.size();
+                sample.cnt = getNnueFeatures(board, swap != 0, features);
+                train_features.insert(train_features.end(), features, features + sample.cnt);
+                sample.hand = (float)(swap ? -evaluateBits(board) : evaluateBits(board));
+                sample.target = (float)(swap ? -record.margin : record.margin);
+                sample.holdout = record.holdout;
+                samples.push_back(sample);
+            }
+            doStepBits(&board, pos, nowPlayer);
+            bit_undo_top = 0;
+        }
+        nowPlayer = !nowPlayer;
+    }
+}
+
+/**
+ * 浮点网络的前向计算，保留反向传播用到的中间结果
+ * @param[out] z1 第一层截断前的值
+ * @param[out] z2 第二层截断前的值
+ * @return 网络输出
+ */
+float forwardFloat(const TrainSample &sample, float *z1, float *z2)
+{
+    memcpy(z1, net_b1, sizeof(net_b1));
+    float out = net_b3;
+    for (int i = 0; i < sample.cnt; i++)
+    {
+        int f = train_features[sample.begin + i];
+        for (int k = 0; k < NNUE_HIDDEN; k++)
+        {
+            z1[k] += net_w1[f][k];
+        }
+        out += net_wp[f];
+    }
+    for (int j = 0; j < NNUE_HIDDEN2; j++)
+    {
+        z2[j] = net_b2[j];
+        for (int k = 0; k < NNUE_HIDDEN; k++)
+        {
+            z2[j] += net_w2[j][k] * min(max(z1[k], 0.0f), 1.0f);
+        }
+        out += net_w3[j] * min(max(z2[j], 0.0f), 1.0f);
+    }
+    return out;
+}
+
+/**
+ * 一个样本上的一步随机梯度下降，损失为 (输出 - 目标)^2 / 2
+ * @param[in] rate 第二层和输出层的学习率，第一层每个特征在样本中出现的次数多，再除以格子数
+ */
+void trainStep(const TrainSample &sample, float target, float rate)
+{
+    float z1[NNUE_HIDDEN], z2[NNUE_HIDDEN2];
+    float err = forwardFloat(sample, z1, z2) - target;
+    float a1[NNUE_HIDDEN], d1[NNUE_HIDDEN] = {};
+    for (int k = 0; k < NNUE_HIDDEN; k++)
+    {
+        a1[k] = min(max(z1[k], 0.0f), 1.0f);
+    }
+    for (int j = 0; j < NNUE_HIDDEN2; j++)
+    {
+        float a2 = min(max(z2[j], 0.0f), 1.0f);
+        float d2 = z2[j] > 0 && z2[j] < 1 ? err * net_w3[j] : 0;
+        net_w3[j] -= rate * err * a2;
+        if (d2 != 0)
+        {
+            for (int k = 0; k < NNUE_HIDDEN; k++)
+            {
+                d1[k] += d2 * net_w2[j][k];
+                net_w2[j][k] -= rate * d2 * a1[k];
+            }
+            net_b2[j] -= rate * d2;
+        }
+    }
+    net_b3 -= rate * err;
+
+    float rate1 = rate / sample.cnt;
+    for (int k = 0; k < NNUE_HIDDEN; k++)
+    {
+        d1[k] = z1[k] > 0 && z1[k] < 1 ? d1[k] * rate1 : 0;
+        net_b1[k] -= d1[k];
+    }
+    for (int i = 0; i < sample.cnt; i++)
+    {
+        int f = train_features[sample.begin + i];
+        for (int k = 0; k < NNUE_HIDDEN; k++)
+        {
+            net_w1[f][k] -= d1[k];
+        }
+        net_wp[f] -= rate1 * err;
+    }
+}
+
+/**
+ * 训练集或验证集上的均方根误差，单位是终局分差
+ * @param[in] scale 网络输出乘以这个数得到终局分差，为 0 时改为比较 a 乘手写评估
+ */
+double getRmse(const vector<TrainSample> &samples, bool holdout, double a, double scale)
+{
+    double sum = 0;
+    long long cnt = 0;
+    float z1[NNUE_HIDDEN], z2[NNUE_HIDDEN2];
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        if (samples[i].holdout == holdout)
+        {
+            double pred = scale > 0 ? forwardFloat(samples[i], z1, z2) * scale : a * samples[i].hand;
+            sum += (pred - samples[i].target) * (pred - samples[i].target);
+            cnt++;
+        }
+    }
+    return sqrt(sum / max(1LL, cnt));
+}
+
+//浮点数四舍五入并截断到 [-limit, limit]
+long long quantize(double value, long long limit)
+{
+    return max(-limit, min(limit, llround(value)));
+}
+
+/**
+ * 量化并写出权重文件
+ * @param[in] out_scale 整数网络的输出乘以这个数得到手写评估的单位
+ * @return false 无法写文件
+ */
+bool writeNnue(const char *path, float out_scale)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    NnueHeader header = {{'C', 'K', 'N', 'N', 'U', 'E', 0, 0}, NNUE_VERSION, NNUE_FEATURES, NNUE_HIDDEN, NNUE_HIDDEN2,
+                         out_scale, 0};
+    fwrite(&header, sizeof(header), 1, file);
+    const double qb = 1 << NNUE_QB_SHIFT;
+    vector<int16_t> w16;
+    vector<int32_t> w32;
+    for (int f = 0; f < NNUE_FEATURES; f++)
+    {
+        for (int k = 0; k < NNUE_HIDDEN; k++)
+        {
+            w16.push_back((int16_t)quantize(net_w1[f][k] * NNUE_QA, 32767));
+        }
+    }
+    for (int k = 0; k < NNUE_HIDDEN; k++)
+    {
+        w16.push_back((int16_t)quantize(net_b1[k] * NNUE_QA, 32767));
+    }
+    for (int f = 0; f < NNUE_FEATURES; f++)
+    {
+        w16.push_back((int16_t)quantize(net_wp[f] * NNUE_QA * qb, 32767));
+    }
+    for (int j = 0; j < NNUE_HIDDEN2; j++)
+    {
+        for (int k = 0; k < NNUE_HIDDEN; k++)
+        {
+            w16.push_back((int16_t)quantize(net_w2[j][k] * qb, 32767));
+        }
+    }
+    fwrite(w16.data(), sizeof(int16_t), w16.size(), file);
+    for (int j = 0; j < NNUE_HIDDEN2; j++)
+    {
+        w32.push_back((int32_t)quantize(net_b2[j] * NNUE_QA * qb, INT_MAX));
+    }
+    fwrite(w32.data(), sizeof(int32_t), w32.size(), file);
+    w16.clear();
+    for (int j = 0; j < NNUE_HIDDEN2; j++)
+    {
+        w16.push_back((int16_t)quantize(net_w3[j] * qb, 32767));
+    }
+    fwrite(w16.data(), sizeof(int16_t), w16.size(), file);
+    int32_t b3 = (int32_t)quantize(net_b3 * NNUE_QA * qb, INT_MAX);
+    fwrite(&b3, sizeof(b3), 1, file);
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 5)
+    {
+        fprintf(stderr, "usage: %s <nnue_file> <games_per_map> <depth> <map_file>...\n", argv[0]);
+        return 1;
+    }
+    const char *nnue_path = argv[1];
+    int games = atoi(argv[2]);
+    int depth = max(1, atoi(argv[3]));
+
+    vector<Player *> players;
+    vector<GameRecord> records;
+    vector<TrainSample> samples;
+    for (int k = 4; k < argc; k++)
+    {
+        Player *player = readTrainMap(argv[k]);
+        if (player == NULL)
+        {
+            fprintf(stderr, "cannot read %s\n", argv[k]);
+            return 1;
+        }
+        players.push_back(player);
+        if (!startMap(player))
+        {
+            fprintf(stderr, "%s: board too large for the bitboard, skipped\n", argv[k]);
+            continue;
+        }
+        mt19937 rng((uint32_t)getMapKey(player));
+        BitBoard start = loadBits(player);
+        size_t before = samples.size();
+        for (int g = 0; g < games; g++)
+        {
+            records.push_back(playGame(start, k - 4, depth, g % TRAIN_HOLDOUT == TRAIN_HOLDOUT - 1, rng));
+            addSamples(start, records.back(), samples);
+        }
+        fprintf(stderr, "%s: strategy %d, %d games, %zu samples\n", argv[k], strategy, games, samples.size() - before);
+    }
+
+    //终局分差对手写评估的最小二乘系数，以及目标的缩放
+    double hh = 0, ht = 0, tt = 0;
+    vector<size_t> order;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        if (!samples[i].holdout)
+        {
+            hh += (double)samples[i].hand * samples[i].hand;
+            ht += (double)samples[i].hand * samples[i].target;
+            tt += (double)samples[i].target * samples[i].target;
+            order.push_back(i);
+        }
+    }
+    double a = hh > 0 ? ht / hh : 0;
+    double scale = sqrt(tt / max((size_t)1, order.size()));
+    if (a <= 0 || scale <= 0)
+    {
+        fprintf(stderr, "no usable samples (a = %g, target rms = %g)\n", a, scale);
+        return 1;
+    }
+
+    //第一层偏置让激活从截断区间的中部开始
+    mt19937 init_rng(20240716);
+    uniform_real_distribution<float> small(-0.05f, 0.05f);
+    uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    for (int f = 0; f < NNUE_FEATURES; f++)
+    {
+        for (int k = 0; k < NNUE_HIDDEN; k++)
+        {
+            net_w1[f][k] = small(init_rng);
+        }
+    }
+    for (int k = 0; k < NNUE_HIDDEN; k++)
+    {
+        net_b1[k] = 0.5f;
+    }
+    for (int j = 0; j < NNUE_HIDDEN2; j++)
+    {
+        for (int k = 0; k < NNUE_HIDDEN; k++)
+        {
+            net_w2[j][k] = unit(init_rng) / sqrt((float)NNUE_HIDDEN);
+        }
+        net_b2[j] = 0.5f;
+        net_w3[j] = unit(init_rng) / sqrt((float)NNUE_HIDDEN2);
+    }
+    net_b3 = 0;
+
+    fprintf(stderr, "a = %.4f  rmse of a * hand: train %.2f  holdout %.2f\n", a, getRmse(samples, false, a, 0),
+            getRmse(samples, true, a, 0));
+
+    mt19937 shuffle_rng(20240716);
+    double rate = TRAIN_RATE;
+    for (int epoch = 0; epoch < TRAIN_EPOCHS; epoch++, rate *= TRAIN_DECAY)
+    {
+        shuffle(order.begin(), order.end(), shuffle_rng);
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            trainStep(samples[order[i]], (float)(samples[order[i]].target / scale), (float)rate);
+        }
+        fprintf(stderr, "epoch %d  rmse train %.2f  holdout %.2f\n", epoch + 1, getRmse(samples, false, a, scale),
+                getRmse(samples, true, a, scale));
+    }
+
+    float out_scale = (float)(scale / a / ((double)NNUE_QA * (1 << NNUE_QB_SHIFT)));
+    if (!writeNnue(nnue_path, out_scale))
+    {
+        fprintf(stderr, "cannot write %s\n", nnue_path);
+        return 1;
+    }
+
+    //载入刚写出的文件，重放留出的棋谱：整数网络的误差，以及增量累加器与从头计算是否一致
+    if (!loadNnueFile(nnue_path))
+    {
+        fprintf(stderr, "cannot load %s\n", nnue_path);
+        return 1;
+    }
+    double int_sum = 0;
+    long long int_cnt = 0, mismatches = 0;
+    int started = -1;
+    for (size_t r = 0; r < records.size(); r++)
+    {
+        const GameRecord &record = records[r];
+        if (!record.holdout)
+        {
+            continue;
+        }
+        if (record.map != started)
+        {
+            startMap(players[record.map]);
+            started = record.map;
+        }
+        BitBoard board = loadBits(players[record.map]);
+        bool nowPlayer = true;
+        for (size_t i = 0; i < record.moves.size(); i++)
+        {
+            if (record.moves[i] >= 0)
+            {
+                double pred = a * evaluateIncr(board);
+                int_sum += (pred - record.margin) * (pred - record.margin);
+                int_cnt++;
+                mismatches += evaluateIncr(board) != evaluateBits(board);
+                doStepBits(&board, record.moves[i], nowPlayer);
+                bit_undo_top = 0;
+            }
+            nowPlayer = !nowPlayer;
+        }
+    }
+    fprintf(stderr, "a = %.4f  holdout rmse: hand %.2f  nnue float %.2f  nnue int %.2f  incremental mismatches %lld\n",
+            a, getRmse(samples, true, a, 0), getRmse(samples, true, a, scale), sqrt(int_sum / max(1LL, int_cnt)),
+            mismatches);
+    fprintf(stderr, "written to %s\n", nnue_path);
+
+    for (size_t k = 0; k < players.size(); k++)
+    {
+        freePlayer(players[k]);
+    }
+    return 0;
+}